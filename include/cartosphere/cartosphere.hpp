@@ -7,6 +7,8 @@ typedef double fftw_real;
 
 #include "cartosphere/solver.hpp"
 
+#include "cartosphere/raster.hpp"
+
 namespace Cartosphere
 {
 	// Spherical cartogram scheme
@@ -32,6 +34,14 @@ namespace Cartosphere
 	public:
 		// Transform a vector of points, timestepping from the solver
 		void transform(vector<Cartosphere::Point>& points)
+		{
+			Cartosphere::PointCloud cloud(points);
+			transform(cloud);
+			points = cloud.points();
+		}
+
+		// Transform a cloud of points, timestepping from the solver
+		void transform(Cartosphere::PointCloud& points)
 		{
 			history.clear();
 			
@@ -45,42 +55,228 @@ namespace Cartosphere
 				status.max_distance = 0;
 				if (recordTrajectory)
 				{
-					status.points = points;
+					status.points = points.points();
 				}
 			}
 			history.push_back(status);
 
+			// Start from time 0
+			Progress progress;
+			progress.iteration = 0;
+			progress.time_elapsed = 0;
+			progress.timestep = firstTimestep;
+			progress.max_distance = DoubleMaximum;
+			_march(points, progress);
+		}
+
+		// Resume a transform of a vector of points from a checkpoint
+		bool resume(const string& path, vector<Cartosphere::Point>& points,
+			string& error)
+		{
+			Cartosphere::PointCloud cloud;
+			if (!resume(path, cloud, error))
+			{
+				return false;
+			}
+			points = cloud.points();
+			return true;
+		}
+
+		// Resume a transform from a checkpoint written by a previous transform
+		// The solver is restored without initialize_solver, and the points are
+		// replaced by those saved in the checkpoint
+		bool resume(const string& path, Cartosphere::PointCloud& points,
+			string& error)
+		{
+			ifstream ifs(path, std::ios::binary | std::ios::ate);
+			if (!ifs.is_open())
+			{
+				error = "The checkpoint " + path + " does not exist.";
+				return false;
+			}
+			std::streamoff length = ifs.tellg();
+			ifs.seekg(0);
+
+			auto read = [&ifs](auto& value) {
+				ifs.read(reinterpret_cast<char*>(&value), sizeof(value));
+			};
+			// Arrays longer than the rest of the file fail the stream instead
+			// of being allocated, and nothing is read after a failure
+			auto read_array = [&ifs, length](vector<double>& values) {
+				values.clear();
+				std::uint64_t n = 0;
+				ifs.read(reinterpret_cast<char*>(&n), sizeof(n));
+				if (!ifs.good())
+				{
+					return;
+				}
+				std::uint64_t remaining = length - ifs.tellg();
+				if (n > remaining / sizeof(double))
+				{
+					ifs.setstate(std::ios::failbit);
+					return;
+				}
+				values.resize(n);
+				ifs.read(reinterpret_cast<char*>(values.data()), n * sizeof(double));
+			};
+
+			// Header
+			std::uint32_t magic = 0, version = 0;
+			read(magic);
+			read(version);
+			if (!ifs.good() || magic != CheckpointMagic || version != CheckpointVersion)
+			{
+				error = "The checkpoint " + path + " has an unknown format.";
+				return false;
+			}
+
+			// Timestepping schedule and progress
+			Progress progress;
+			std::uint8_t adaptivity = 0;
+			read(adaptivity);
+			read(firstTimestep);
+			read(ratioTimestep);
+			read(progress.iteration);
+			read(progress.time_elapsed);
+			read(progress.timestep);
+			read(progress.max_distance);
+			timeAdaptivity = adaptivity;
+
+			// Convergence statistics
+			vector<double> stats;
+			read_array(stats);
+
+			// Points
+			vector<double> x, y, z;
+			read_array(x);
+			read_array(y);
+			read_array(z);
+
+			// Solver state
+			vector<double> payload;
+			read_array(payload);
+
+			if (!ifs.good() || stats.size() % 5 != 0
+				|| x.size() != y.size() || x.size() != z.size())
+			{
+				error = "The checkpoint " + path + " is truncated.";
+				return false;
+			}
+			if (!restore_solver(payload))
+			{
+				// Solvers that do not checkpoint leave the payload empty
+				error = payload.empty()
+					? "The checkpoint " + path + " has no solver state to resume from."
+					: "The checkpoint " + path + " does not match the solver.";
+				return false;
+			}
+
+			history.clear();
+			for (size_t i = 0; i < stats.size(); i += 5)
+			{
+				Snapshot status;
+				status.time_begin = stats[i];
+				status.time_final = stats[i + 1];
+				status.duration = stats[i + 2];
+				status.max_speed = stats[i + 3];
+				status.max_distance = stats[i + 4];
+				history.push_back(status);
+			}
+			points.assign(std::move(x), std::move(y), std::move(z));
+			if (recordTrajectory && !history.empty())
+			{
+				history.back().points = points.points();
+			}
+
+			_march(points, progress);
+			return true;
+		}
+
+	protected:
+		// Progress of the timestepping loop
+		struct Progress
+		{
+			// Iterations done so far
+			int iteration;
+			// Time reached and the timestep to take from there
+			double time_elapsed;
+			double timestep;
+			// Distance travelled in the last iteration
+			double max_distance;
+		};
+
+		// Identify checkpoint files ("CSCK" in little-endian)
+		static constexpr std::uint32_t CheckpointMagic = 0x4b435343;
+		static constexpr std::uint32_t CheckpointVersion = 1;
+
+		// Run the timestepping loop from the given progress
+		void _march(Cartosphere::PointCloud& points, Progress progress)
+		{
+			Snapshot status;
+
 			// Prepare to loop
-			double timeElapsed = 0;
-			double timestep = firstTimestep;
-			double epsilon = DoubleMaximum;
-			double maxDistance = DoubleMaximum;
+			double timeElapsed = progress.time_elapsed;
+			double timestep = progress.timestep;
+			double maxDistance = progress.max_distance;
+			auto lastCheckpoint = steady_clock::now();
+			checkpointError.clear();
+			// Batches of future time levels are prepared on demand
+			preparedUntil = -DoubleMaximum;
+
+			// In pipelined mode the field at the current time is always ready
+			// at the start of an iteration; solvers without a back buffer
+			// step synchronously
+			bool overlap = pipelined && _buffered();
+			if (overlap)
+			{
+				_prepare(timeElapsed, timestep);
+				advance_solver(timeElapsed, 0);
+			}
 
 			// Loop while conditions unchange
 			bool isExpired, isConvergent;
 			vector<FL3> velocities(points.size());
-			for (int iteration = 0; iteration < maxIterations; ++iteration)
+			for (int iteration = progress.iteration; iteration < maxIterations; ++iteration)
 			{
 				// Compute velocity field
-				advance_solver(timeElapsed, 0);
+				// When pipelined, the field for the next iteration is
+				// synthesized in the background while the points move
+				std::future<void> prefetch;
+				if (overlap)
+				{
+					double timeNext = timeElapsed + timestep;
+					double stepNext = _next_timestep(timeNext, timestep);
+					prefetch = std::async(std::launch::async,
+						[this, timeNext, stepNext]() {
+							_prepare(timeNext, stepNext);
+							prefetch_solver(timeNext, 0);
+						});
+				}
+				else
+				{
+					_prepare(timeElapsed, timestep);
+					advance_solver(timeElapsed, 0);
+				}
 				velocity(points, velocities);
 
 				// Use velocity field to perform time step.
-				FL3 travel;
-				double travelDistance;
-				double slack;
-				maxDistance = 0;
-				for (size_t i = 0; i < points.size(); ++i)
+				double slack = (1 - exp(-2 * timestep)) / (2 * timestep);
+				double scale = timestep * slack;
+				points.move(velocities, scale);
+
+				// The longest travel belongs to the fastest point
+				double maxSpeed = 0;
+				for (size_t i = 0; i < velocities.size(); ++i)
 				{
-					slack = (1 - exp(-2 * timestep)) / (2 * timestep);
-					travel = timestep * velocities[i] * slack;
-					points[i].move(travel);
+					maxSpeed = std::max(maxSpeed, velocities[i].norm2());
+				}
+				maxDistance = scale * maxSpeed;
 
-					travelDistance = travel.norm2();
-					if (travelDistance > maxDistance)
-					{
-						maxDistance = travelDistance;
-					}
+				// Bring the field for the next iteration to the front
+				if (overlap)
+				{
+					prefetch.wait();
+					swap_solver();
 				}
 
 				// DO OUR OWN THING
@@ -91,20 +287,13 @@ namespace Cartosphere
 				status.max_distance = maxDistance;
 				if (recordTrajectory)
 				{
-					status.points = points;
+					status.points = points.points();
 				}
 				history.push_back(status);
 
 				// Prepare for next iteration
 				timeElapsed += timestep;
-				if (timeAdaptivity)
-				{
-					timestep = firstTimestep * exp(2 * timeElapsed);
-				}
-				else
-				{
-					timestep *= ratioTimestep;
-				}
+				timestep = _next_timestep(timeElapsed, timestep);
 
 				// Judge loop criterions
 				{
@@ -115,7 +304,171 @@ namespace Cartosphere
 				{
 					break;
 				}
+
+				// Save a checkpoint every so many iterations or seconds
+				if (!checkpointPath.empty())
+				{
+					double seconds = duration_cast<milliseconds>(
+						steady_clock::now() - lastCheckpoint).count() / 1000.0;
+					bool byIterations = checkpointIterations > 0
+						&& (iteration + 1) % checkpointIterations == 0;
+					bool bySeconds = checkpointSeconds > 0
+						&& seconds >= checkpointSeconds;
+					if (byIterations || bySeconds)
+					{
+						progress.iteration = iteration + 1;
+						progress.time_elapsed = timeElapsed;
+						progress.timestep = timestep;
+						progress.max_distance = maxDistance;
+						_checkpoint(points, progress);
+						lastCheckpoint = steady_clock::now();
+					}
+				}
 			}
+
+			// The last checkpoint must be on disk before returning
+			_await_checkpoint();
+		}
+
+		// Wait for the checkpoint being written, and record its failure
+		void _await_checkpoint()
+		{
+			if (checkpointWrite.valid())
+			{
+				string error = checkpointWrite.get();
+				if (!error.empty())
+				{
+					checkpointError = error;
+				}
+			}
+		}
+
+		// Serialize the state, then write it in the background
+		// The previous write is waited upon, so at most one is in flight
+		void _checkpoint(const Cartosphere::PointCloud& points,
+			const Progress& progress)
+		{
+			vector<char> buffer;
+			auto write = [&buffer](const auto& value) {
+				const char* bytes = reinterpret_cast<const char*>(&value);
+				buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+			};
+			auto write_array = [&buffer, &write](const vector<double>& values) {
+				write((std::uint64_t)values.size());
+				const char* bytes = reinterpret_cast<const char*>(values.data());
+				buffer.insert(buffer.end(), bytes, bytes + values.size() * sizeof(double));
+			};
+
+			// Header
+			write(CheckpointMagic);
+			write(CheckpointVersion);
+
+			// Timestepping schedule and progress
+			write((std::uint8_t)timeAdaptivity);
+			write(firstTimestep);
+			write(ratioTimestep);
+			write(progress.iteration);
+			write(progress.time_elapsed);
+			write(progress.timestep);
+			write(progress.max_distance);
+
+			// Convergence statistics
+			vector<double> stats;
+			stats.reserve(history.size() * 5);
+			for (const auto& status : history)
+			{
+				stats.insert(stats.end(), { status.time_begin, status.time_final,
+					status.duration, status.max_speed, status.max_distance });
+			}
+			write_array(stats);
+
+			// Points
+			write_array(points.xs());
+			write_array(points.ys());
+			write_array(points.zs());
+
+			// Solver state
+			vector<double> payload;
+			checkpoint_solver(payload);
+			write_array(payload);
+
+			// Write into a temporary file first, so that a crash mid-write
+			// leaves the previous checkpoint intact
+			_await_checkpoint();
+			checkpointWrite = std::async(std::launch::async,
+				[target = checkpointPath, buffer = std::move(buffer)]() -> string {
+					string temporary = target + ".tmp";
+					ofstream ofs(temporary, std::ios::binary);
+					ofs.write(buffer.data(), buffer.size());
+					ofs.close();
+					std::error_code ec;
+					if (!ofs.good())
+					{
+						std::filesystem::remove(temporary, ec);
+						return "Cannot write the checkpoint " + temporary + ".";
+					}
+					std::filesystem::rename(temporary, target, ec);
+					if (ec)
+					{
+						return "Cannot rename the checkpoint to " + target
+							+ ": " + ec.message() + ".";
+					}
+					return string();
+				});
+		}
+
+	protected:
+		// Does the solver declare its own version of a hook?
+		template <typename Hook, typename Default>
+		static constexpr bool _overrides = !std::is_same_v<Hook, Default>;
+
+		// Does the solver keep a back buffer that prefetch_solver fills?
+		static constexpr bool _buffered()
+		{
+			return _overrides<decltype(&DerivedType::prefetch_solver),
+				decltype(&SolverWrapper::prefetch_solver)> &&
+				_overrides<decltype(&DerivedType::swap_solver),
+				decltype(&SolverWrapper::swap_solver)>;
+		}
+
+		// Does the solver compute velocities at a cloud of points?
+		template <typename T>
+		static auto _takes_cloud(int) -> decltype(std::declval<const T&>().velocity(
+			std::declval<const Cartosphere::PointCloud&>(),
+			std::declval<vector<FL3>&>()), std::true_type());
+		template <typename T>
+		static std::false_type _takes_cloud(...);
+
+		// Timestep taken at time, following a step of size timestep
+		double _next_timestep(double time, double timestep) const
+		{
+			if (timeAdaptivity)
+			{
+				return firstTimestep * exp(2 * time);
+			}
+			else
+			{
+				return timestep * ratioTimestep;
+			}
+		}
+
+		// Prepare the next batch of time levels starting at time, if needed
+		// The schedule is replayed exactly as the loop in transform does
+		void _prepare(double time, double timestep)
+		{
+			if (batchLevels <= 1 || time <= preparedUntil)
+			{
+				return;
+			}
+			vector<double> times(batchLevels);
+			for (int level = 0; level < batchLevels; ++level)
+			{
+				times[level] = time;
+				time += timestep;
+				timestep = _next_timestep(time, timestep);
+			}
+			preparedUntil = times.back();
+			prepare_solver(times);
 		}
 
 	protected:
@@ -133,6 +486,30 @@ namespace Cartosphere
 		// Adaptively compute time?
 		bool timeAdaptivity = false;
 
+		// Overlap the solver with the point advection?
+		bool pipelined = false;
+
+		// Number of time levels prepared per batch, 1 disables batching
+		int batchLevels = 1;
+
+		// Checkpoint file, empty disables checkpointing
+		string checkpointPath;
+
+		// Checkpoint every so many iterations, 0 disables the criterion
+		int checkpointIterations = 0;
+
+		// Checkpoint every so many seconds, 0 disables the criterion
+		double checkpointSeconds = 0;
+
+		// Checkpoint being written in the background, and its error if any
+		std::future<string> checkpointWrite;
+
+		// Error of the last failed checkpoint in the current transform
+		string checkpointError;
+
+		// Last time level prepared in the current transform
+		double preparedUntil = 0;
+
 		// Initial timestep size
 		double firstTimestep = 1e-3;
 
@@ -152,12 +529,92 @@ namespace Cartosphere
 			(reinterpret_cast<DerivedType*>(this))->advance_solver(time, delta);
 		}
 
+		// Advance solver into a back buffer that velocity does not read
+		// Solvers without a back buffer advance in place
+		void prefetch_solver(double time, double delta)
+		{
+			if constexpr (_buffered())
+			{
+				(reinterpret_cast<DerivedType*>(this))->prefetch_solver(time, delta);
+			}
+			else
+			{
+				advance_solver(time, delta);
+			}
+		}
+
+		// Swap the back buffer filled by prefetch_solver to the front
+		// Solvers without a back buffer have nothing to swap
+		void swap_solver()
+		{
+			if constexpr (_buffered())
+			{
+				(reinterpret_cast<DerivedType*>(this))->swap_solver();
+			}
+		}
+
+		// Prepare several future time levels at once
+		// Solvers without a cache prepare nothing
+		void prepare_solver(const vector<double>& times)
+		{
+			if constexpr (_overrides<decltype(&DerivedType::prepare_solver),
+				decltype(&SolverWrapper::prepare_solver)>)
+			{
+				(reinterpret_cast<DerivedType*>(this))->prepare_solver(times);
+			}
+		}
+
+		// Save whatever the solver needs to resume without initialize_solver
+		// Solvers that cannot resume save an empty payload
+		void checkpoint_solver(vector<double>& payload) const
+		{
+			if constexpr (_overrides<decltype(&DerivedType::checkpoint_solver),
+				decltype(&SolverWrapper::checkpoint_solver)>)
+			{
+				(reinterpret_cast<const DerivedType*>(this))->checkpoint_solver(payload);
+			}
+			else
+			{
+				payload.clear();
+			}
+		}
+
+		// Restore the solver from a payload of checkpoint_solver
+		// Solvers that cannot resume refuse every payload
+		bool restore_solver(const vector<double>& payload)
+		{
+			if constexpr (_overrides<decltype(&DerivedType::restore_solver),
+				decltype(&SolverWrapper::restore_solver)>)
+			{
+				return (reinterpret_cast<DerivedType*>(this))->restore_solver(payload);
+			}
+			else
+			{
+				return false;
+			}
+		}
+
 		// Compute velocity at given points
 		void velocity(const vector<Cartosphere::Point>& points, vector<FL3>& velocities) const
 		{
 			return (reinterpret_cast<const DerivedType*>(this))->velocity(points, velocities);
 		}
 
+		// Compute velocity at given points
+		// Solvers without an overload for clouds are given a list of points
+		void velocity(const Cartosphere::PointCloud& points, vector<FL3>& velocities) const
+		{
+			const DerivedType* derived = reinterpret_cast<const DerivedType*>(this);
+			if constexpr (decltype(_takes_cloud<DerivedType>(0))::value)
+			{
+				derived->velocity(points, velocities);
+			}
+			else
+			{
+				derived->velocity(points.points(), velocities);
+			}
+		}
+
 		// Output a report
 		void format_matlab(const string& prefix) const
 		{
@@ -243,6 +700,28 @@ namespace Cartosphere
 		void enable_time_adaptivity() { timeAdaptivity = true; }
 		void disable_time_adaptivity() { timeAdaptivity = false; }
 
+		// Enable/Disable pipelining
+		// Solvers without a back buffer keep stepping synchronously
+		void enable_pipelining() { pipelined = true; }
+		void disable_pipelining() { pipelined = false; }
+
+		// Get/Set batchLevels
+		int get_batch_levels() const { return batchLevels; }
+		void set_batch_levels(int n) { if (n > 0) batchLevels = n; }
+
+		// Enable/Disable checkpoints every so many iterations or seconds
+		void enable_checkpoint(const string& path, int iterations, double seconds = 0)
+		{
+			checkpointPath = path;
+			checkpointIterations = std::max(iterations, 0);
+			checkpointSeconds = std::max(seconds, 0.0);
+		}
+		void disable_checkpoint() { checkpointPath.clear(); }
+
+		// Get the error of the last checkpoint that could not be written
+		// during the latest transform, empty if all were written
+		const string& get_checkpoint_error() const { return checkpointError; }
+
 		// Get/Set firstTimeStep
 		double get_first_timestep() const { return firstTimestep; }
 		void set_first_timestep(double t) { if (t > 0) firstTimestep = t; }
@@ -263,6 +742,23 @@ namespace Cartosphere
 	// Spectral cartogram generator
 	class SpectralGlobe : public SolverWrapper<Cartosphere::SpectralGlobe>
 	{
+	public:
+		// Synthesized data and gradient at a given time
+		struct Field
+		{
+			// Fourier coefficients
+			vector<double> hats;
+			// Data and partials on the grid
+			vector<double> data;
+			vector<double> dp;
+			vector<double> da;
+			// Pole data
+			double data_north = 0;
+			double data_south = 0;
+			FL3 grad_north = { 0, 0, 0 };
+			FL3 grad_south = { 0, 0, 0 };
+		};
+
 	public:
 		// Default constructor
 		SpectralGlobe() {}
@@ -279,28 +775,76 @@ namespace Cartosphere
 		// Advance solver
 		void advance_solver(double time, double delta);
 
+		// Advance solver into the back buffer
+		void prefetch_solver(double time, double delta);
+
+		// Swap the back buffer to the front
+		void swap_solver();
+
+		// Synthesize all given time levels in one batch into the cache
+		void prepare_solver(const vector<double>& times);
+
+		// Save the bandlimit and the initial Fourier coefficients
+		void checkpoint_solver(vector<double>& payload) const;
+
+		// Restore the bandlimit and the initial Fourier coefficients
+		bool restore_solver(const vector<double>& payload);
+
 		// Compute velocity
 		void velocity(const vector<Cartosphere::Point>& points,
 			vector<FL3>& velocities) const;
 
+		// Compute velocity
+		void velocity(const Cartosphere::PointCloud& points,
+			vector<FL3>& velocities) const;
+
 	protected:
-		// Data at time 0 and time t
+		// (Re)allocate grids, workspace and plans for the bandlimit
+		void _allocate();
+
+		// Reset the history, the cache and the pole data
+		void _reset();
+
+		// Deallocate the batched transform
+		void _cleanup_batch();
+
+		// Take the field at time t from the cache, or synthesize it
+		void _fetch(double t, Field& field);
+
+		// Synthesize the field at time t
+		void _synthesize(double t, Field& field);
+
+		// Decay the initial Fourier coefficients to time t
+		void _decay(double t, double* hats) const;
+
+		// Compute data and gradients at the poles from synthesized grids
+		void _poles(Field& field) const;
+
+		// Log the grids used by velocity
+		void _log_grids() const;
+
+		// Interpolate the velocity at a point with known trigs
+		FL3 _velocity(double theta, double phi,
+			double cos_theta, double sin_theta,
+			double cos_phi, double sin_phi) const;
+
+	protected:
+		// Data and Fourier at time 0
 		vector<double> init_data;
-		vector<double> time_data;
-		
-		// Fourier at time 0 and time t
 		vector<double> init_hats;
-		vector<double> time_hats;
 
-		// Partials and gradient at time t
-		vector<double> time_dp;
-		vector<double> time_da;
+		// Regions rasterized at time 0, in place of the initial condition
+		Cartosphere::Rasterizer init_regions;
 
-		// Pole data
-		double time_data_north = 0;
-		double time_data_south = 0;
-		FL3 time_grad_north = { 0, 0, 0 };
-		FL3 time_grad_south = { 0, 0, 0 };
+		// Field at time t, used to compute velocities
+		Field time_field;
+		// Field synthesized ahead of time by prefetch_solver
+		Field next_field;
+
+		// Fields synthesized ahead of time by prepare_solver
+		map<double, Field> cache;
+		// Keep cached fields after use, for transforms with the same schedule
+		bool replay = false;
 
 		// Allocations for S2 transformations
 		vector<double> ws2;
@@ -308,6 +852,12 @@ namespace Cartosphere
 		fftw_plan idct = NULL;
 		fftw_plan idst = NULL;
 
+		// Allocations for batched S2 transformations
+		int bcount = 0;
+		fftw_real* bpad = nullptr;
+		fftw_plan bidct = NULL;
+		fftw_plan bidst = NULL;
+
 		// Bandlimit and data size
 		int B = 0;
 		int N = 0;
@@ -316,6 +866,15 @@ namespace Cartosphere
 		// Get/Set bandlimit: must be a whole power of 2 and even
 		int get_bandlimit() const { return B; }
 		void set_bandlimit(int B) { if (B > 0) this->B = B; }
+
+		// Get/Set regions, which take precedence over the initial condition
+		// Set an empty Rasterizer to sample the initial condition again
+		const Cartosphere::Rasterizer& get_initial_regions() const { return init_regions; }
+		void set_initial_regions(const Cartosphere::Rasterizer& r) { init_regions = r; }
+
+		// Enable/Disable replay of cached fields
+		void enable_replay() { replay = true; }
+		void disable_replay() { replay = false; cache.clear(); }
 	};
 
 	// Finite element cartogram generator
@@ -331,6 +890,15 @@ namespace Cartosphere
 		// Compute velocity
 		void velocity(const vector<Cartosphere::Point>& points,
 			vector<FL3>& velocities) const;
+
+	protected:
+		// Background mesh
+		Cartosphere::TriangularMesh mesh;
+
+	public:
+		// Get/Set background mesh
+		const Cartosphere::TriangularMesh& get_mesh() const { return mesh; }
+		void set_mesh(const Cartosphere::TriangularMesh& m) { mesh = m; }
 	};
 }
 
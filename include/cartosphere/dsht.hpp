@@ -30,6 +30,19 @@ void cs_ids2ht_dp(int B, const double* harmonics, double* partials, const double
 void cs_ids2ht_da(int B, const double* harmonics, double* partials, const double* ws2,
 	fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst);
 
+// Batched inverse transforms over count sets of harmonics
+// Harmonics are count * B * B, data or partials are count * N * N
+// Each x_{j}-file of the workspace is reused across the whole batch
+// The scratchpad and plans must come from cs_ids2ht_plans_many(B, count, ...)
+void cs_ids2ht_many(int B, int count, const double* harmonics, double* data,
+	const double* ws2, fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst);
+
+void cs_ids2ht_dp_many(int B, int count, const double* harmonics, double* partials,
+	const double* ws2, fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst);
+
+void cs_ids2ht_da_many(int B, int count, const double* harmonics, double* partials,
+	const double* ws2, fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst);
+
 // Generate, semi-interweaved DCT-III and DST-III plans for cs_ids2ht usage
 //      // Assume harmonics is B * B and data is N * N
 //      int N = 2 * B;
@@ -45,12 +58,20 @@ void cs_ids2ht_da(int B, const double* harmonics, double* partials, const double
 void cs_ids2ht_plans(int B, fftw_real* pad,
 	fftw_plan* ptr_many_idct, fftw_plan* ptr_many_idst);
 
+// Same as above, but for count sets of harmonics at once
+// The scratchpad must hold count * N * N * 2 elements
+void cs_ids2ht_plans_many(int B, int count, fftw_real* pad,
+	fftw_plan* ptr_many_idct, fftw_plan* ptr_many_idst);
+
 // Given a valid scratch pad
 // Properly execute FFTW plans to obtain desired inverse transform
 // Internal to cs_ids2ht, cs_ids2ht_dp, cs_ids2ht_da
 void cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	fftw_plan many_idct, fftw_plan many_idst);
 
+void cs_ids2ht_execute_many(int B, int count, fftw_real* pad, fftw_real* data,
+	fftw_plan many_idct, fftw_plan many_idst);
+
 // Allocate a workspace for bandlimit B
 // Remember to free it using delete[]!
 // WARNING: B must be a positive even number!
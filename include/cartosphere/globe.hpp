@@ -19,9 +19,20 @@ namespace Cartosphere
 		// Output the result
 		void format(const string& path);
 
+	public:
+		// Regions read from file
+		const vector<string>& names() const { return _names; }
+		const vector<double>& values() const { return _values; }
+		const vector<Cartosphere::Polygon>& polygons() const { return _polygons; }
+
 	private:
 		// Internal computational mesh
 		Cartosphere::TriangularMesh _m;
+
+		// Regions read from file
+		vector<string> _names;
+		vector<double> _values;
+		vector<Cartosphere::Polygon> _polygons;
 	};
 }
 
@@ -178,6 +178,67 @@ namespace Cartosphere
 
 	typedef std::function<double(const Point&)> Function;
 
+	// A structure-of-arrays collection of points on the unit sphere
+	// Only the Cartesian coordinates are authoritative: the spherical angles
+	// are computed on demand and cached until the next modification.
+	class PointCloud
+	{
+	public:
+		// Default constructor
+		PointCloud() = default;
+		// Construct from a list of points
+		PointCloud(const vector<Point>& points) { assign(points); }
+
+	public:
+		// Number of points
+		size_t size() const { return _x.size(); }
+		// Is the cloud empty?
+		bool empty() const { return _x.empty(); }
+		// Obtain x-coordinate
+		inline double x(size_t i) const { return _x[i]; }
+		// Obtain y-coordinate
+		inline double y(size_t i) const { return _y[i]; }
+		// Obtain z-coordinate
+		inline double z(size_t i) const { return _z[i]; }
+		// Obtain polar angle (fills the cache if necessary)
+		inline double p(size_t i) const { refresh(); return _p[i]; }
+		// Obtain azimuthal angle (fills the cache if necessary)
+		inline double a(size_t i) const { refresh(); return _a[i]; }
+		// Obtain image
+		inline Image image(size_t i) const { return Image(_x[i], _y[i], _z[i]); }
+		// Obtain a point
+		Point point(size_t i) const;
+		// Convert to a list of points
+		vector<Point> points() const;
+		// Obtain the coordinate arrays
+		const vector<double>& xs() const { return _x; }
+		const vector<double>& ys() const { return _y; }
+		const vector<double>& zs() const { return _z; }
+
+	public:
+		// Replace the content with a list of points
+		void assign(const vector<Point>& points);
+		// Replace the content with coordinate arrays of equal length
+		void assign(vector<double> x, vector<double> y, vector<double> z);
+		// Remove all points
+		void clear();
+		// Set the image of a point
+		void set(size_t i, const Image& image);
+		// Move each point along its own tangent displacement times a scale
+		void move(const vector<FL3>& displacements, double scale = 1);
+		// Fill the cache of spherical coordinates if it is stale
+		// Call before reading angles from multiple threads
+		void refresh() const;
+
+	private:
+		// Cartesian coordinates
+		vector<double> _x, _y, _z;
+		// Cached polar and azimuthal angles
+		mutable vector<double> _p, _a;
+		// Cache flag
+		mutable bool _bPreimageReady = false;
+	};
+
 	// Representation of a directional minor arc and its local coordinate system
 	class Arc
 	{
@@ -290,12 +351,111 @@ namespace Cartosphere
 		Cap(const Point& apex, double radius) : _a(apex), _r(radius) {}
 
 	public:
-		// Circumscription calculation
+		// Circumscription calculation: the minimum cap enclosing a range of
+		// points, by Welzl's algorithm over a shuffled copy of the range
+		// Points not within an open hemisphere yield the whole sphere
 		template <class ForIt>
 		static Cap circumscribe(ForIt first, ForIt last)
 		{
-			// TODO
-			return Cap();
+			vector<FL3> v;
+			for (; first != last; ++first)
+			{
+				v.push_back(first->image().to_vector());
+			}
+			if (v.empty())
+			{
+				return Cap();
+			}
+
+			// Shared vertices would make the three-point caps degenerate
+			auto less = [](const FL3& a, const FL3& b) {
+				return a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z)));
+			};
+			auto equal = [](const FL3& a, const FL3& b) {
+				return a.x == b.x && a.y == b.y && a.z == b.z;
+			};
+			std::sort(v.begin(), v.end(), less);
+			v.erase(std::unique(v.begin(), v.end(), equal), v.end());
+			std::shuffle(v.begin(), v.end(), std::minstd_rand((unsigned)v.size() + 1));
+
+			// Welzl's algorithm requires an open hemisphere: test the one
+			// centered at the mean direction, and fall back on the (loose)
+			// cap around the mean direction otherwise
+			FL3 mean(0, 0, 0);
+			for (const FL3& x : v)
+			{
+				mean += x;
+			}
+			if (mean.norm2sq() == 0)
+			{
+				return Cap(Point(Image(0, 0, 1)), M_PI);
+			}
+			mean /= std::sqrt(mean.norm2sq());
+			double cos_loose = 1;
+			for (const FL3& x : v)
+			{
+				cos_loose = std::min(cos_loose, dot(mean, x));
+			}
+			Cap loose(Point(Image(mean)), acos(std::max(cos_loose, -1.0)));
+			if (cos_loose <= 0)
+			{
+				return loose;
+			}
+
+			// Apex and cosine of the radius
+			FL3 c = v[0];
+			double cos_r = 1;
+			auto inside = [&c, &cos_r](const FL3& x) {
+				return dot(c, x) >= cos_r - 1e-12;
+			};
+			auto through2 = [&c, &cos_r](const FL3& a, const FL3& b) {
+				c = normalize(a + b);
+				cos_r = dot(c, a);
+			};
+			auto through3 = [&c, &cos_r, &through2](const FL3& a, const FL3& b, const FL3& d) {
+				FL3 n = cross(b - a, d - a);
+				if (n.norm2sq() > 0)
+				{
+					c = normalize(dot(n, a) < 0 ? -n : n);
+					cos_r = dot(c, a);
+				}
+				else
+				{
+					// Collinear points: the cap through the farthest pair
+					double ab = dot(a, b), ad = dot(a, d), bd = dot(b, d);
+					if (ab <= ad && ab <= bd) through2(a, b);
+					else if (ad <= bd) through2(a, d);
+					else through2(b, d);
+				}
+			};
+			for (size_t i = 1; i < v.size(); ++i)
+			{
+				if (inside(v[i])) continue;
+				c = v[i];
+				cos_r = 1;
+				for (size_t j = 0; j < i; ++j)
+				{
+					if (inside(v[j])) continue;
+					through2(v[i], v[j]);
+					for (size_t k = 0; k < j; ++k)
+					{
+						if (inside(v[k])) continue;
+						through3(v[i], v[j], v[k]);
+					}
+				}
+			}
+
+			// Numerical trouble falls back to the loose cap as well
+			bool valid = !c.anynan() && cos_r > 0;
+			for (size_t i = 0; valid && i < v.size(); ++i)
+			{
+				valid = inside(v[i]);
+			}
+			if (!valid || cos_r < cos_loose)
+			{
+				return loose;
+			}
+			return Cap(Point(Image(c)), acos(std::min(cos_r, 1.0)));
 		}
 
 	public:
@@ -315,6 +475,43 @@ namespace Cartosphere
 		double _r = 0;
 	};
 
+	// A linear finite element on a spherical triangle: the distance to the
+	// great circle through the opposite edge, normalized by the height
+	class Element
+	{
+	public:
+		// Default constructor
+		Element() = default;
+		// Construct from the pole of the opposite edge and the vertex
+		Element(const FL3& pole, const FL3& vertex) :
+			_pole(pole), _height(asin(dot(pole, vertex))) {}
+
+	public:
+		// Evaluate at a unit vector
+		double operator()(const FL3& x) const
+		{
+			return asin(std::max(-1.0, std::min(1.0, dot(_pole, x)))) / _height;
+		}
+		// Evaluate at a point
+		double operator()(const Point& x) const { return (*this)(x.image()); }
+		// Gradient at a unit vector: the unit tangent towards the pole,
+		// divided by the height
+		FL3 gradient(const FL3& x) const
+		{
+			return normalize(_pole - dot(_pole, x) * x) / _height;
+		}
+		// Pole of the opposite edge
+		const FL3& pole() const { return _pole; }
+		// Distance from the vertex to the opposite edge
+		double height() const { return _height; }
+
+	protected:
+		// Pole of the opposite edge
+		FL3 _pole;
+		// Distance from the vertex to the opposite edge
+		double _height = 1;
+	};
+
 	// A (spherical) triangle
 	class Triangle
 	{
@@ -333,7 +530,28 @@ namespace Cartosphere
 			Refinement7,
 			Refinement8,
 			Refinement9,
-			Refinement10
+			Refinement10,
+			// Symmetric rules exact up to a polynomial degree on the
+			// reference triangle, following Dunavant and Xiao-Gimbutas
+			Gauss2,
+			Gauss3,
+			Gauss4,
+			Gauss5,
+			Gauss6,
+			Gauss7,
+			Gauss8,
+			Gauss9,
+			Gauss10,
+			Gauss11,
+			Gauss12,
+			Gauss13,
+			Gauss14,
+			Gauss15,
+			Gauss16,
+			Gauss17,
+			Gauss18,
+			Gauss19,
+			Gauss20
 		};
 		static const Integrator DefaultIntegrator = Integrator::Refinement3;
 
@@ -373,15 +591,136 @@ namespace Cartosphere
 		// Compute a circumcircle
 		Cap circumcircle() const;
 		// Obtain a finite element
-		Function element(size_t index) const;
+		Function element(size_t index) const { return basis(index); }
+		// Obtain a finite element without type erasure
+		Element basis(size_t index) const;
 		// Obtain a gradient vector element
 		FL3 gradient(size_t index) const;
 		// Obtain a gradient vector element at an interior point
 		FL3 gradient(size_t index, const Point &p) const;
-		// Numerically integrate a scalar function
-		double integrate(const Function& f, Integrator intr) const;
+		// Numerically integrate a scalar function of a Point or of a unit
+		// vector (FL3), the latter skipping the conversion to a Point
+		template<typename F>
+		double integrate(const F& f, Integrator intr) const;
+		// Visit the quadrature nodes as kernel(x, w), with unit vectors x and
+		// weights w summing to the area
+		template<typename K>
+		void quadrature(const K& kernel, Integrator intr) const
+		{
+			quadrature(A.image(), B.image(), C.image(), area(), kernel, intr);
+		}
+
+	public:
+		// Numerically integrate over the triangle with vertices a, b, c and
+		// a known area
+		template<typename F>
+		static double integrate(const FL3& a, const FL3& b, const FL3& c,
+			double area, const F& f, Integrator intr);
+		// Visit the quadrature nodes of the triangle with vertices a, b, c
+		// and a known area
+		template<typename K>
+		static void quadrature(const FL3& a, const FL3& b, const FL3& c,
+			double area, const K& kernel, Integrator intr);
+
+	public:
+		// A quadrature rule on the reference triangle
+		struct Rule
+		{
+			// Barycentric coordinates of the nodes
+			vector<FL3> nodes;
+			// Weights of the nodes, summing to one
+			vector<double> weights;
+		};
+		// Rule of a refinement or Gauss integrator, computed once
+		// Refinement rules take the centroids of the 4^K triangles of the
+		// uniformly subdivided reference triangle
+		static const Rule& rule(Integrator intr);
+		// Number of function evaluations per triangle
+		static size_t evaluations(Integrator intr);
 	};
 
+	template<typename F>
+	double Triangle::integrate(const F& f, Integrator intr) const
+	{
+		return integrate(A.image(), B.image(), C.image(), area(), f, intr);
+	}
+
+	template<typename F>
+	double Triangle::integrate(const FL3& a, const FL3& b, const FL3& c,
+		double area, const F& f, Integrator intr)
+	{
+		double integral = 0;
+		quadrature(a, b, c, area, [&f, &integral](const FL3& x, double w) {
+			if constexpr (std::is_invocable_v<const F&, const FL3&>)
+			{
+				integral += w * f(x);
+			}
+			else
+			{
+				integral += w * f(Point(Image(x)));
+			}
+		}, intr);
+		return integral;
+	}
+
+	template<typename K>
+	void Triangle::quadrature(const FL3& a, const FL3& b, const FL3& c,
+		double area, const K& kernel, Integrator intr)
+	{
+		switch (intr)
+		{
+		case Integrator::Centroid:
+		{
+			// Taking the function value at the centroid
+			kernel(normalize(a + b + c), area);
+		} break;
+		case Integrator::ThreeVertices:
+		{
+			// Taking the averages of the three vertices
+			double w = area / 3;
+			kernel(a, w);
+			kernel(b, w);
+			kernel(c, w);
+		} break;
+		case Integrator::Simpsons:
+		{
+			// Analogy to Simpson's rule
+			double w = area / 6;
+			kernel(a, w);
+			kernel(b, w);
+			kernel(c, w);
+			kernel(normalize(a + b + c), 3 * w);
+		} break;
+		default:
+		{
+			// Map the reference triangle onto the planar triangle ABC, and
+			// then radially onto the sphere. The radial projection of a planar
+			// point x scales areas by d/|x|^3, where d is the distance from O
+			// to plane ABC
+			// Refer to: https://en.wikipedia.org/wiki/Gnomonic_projection
+			// The constant factors cancel out once weights are normalized to
+			// the exact spherical area, which keeps constants integrated exactly
+			const Rule& r = rule(intr);
+			double weights = 0;
+			for (size_t k = 0; k < r.nodes.size(); ++k)
+			{
+				const FL3& node = r.nodes[k];
+				double r2 = (a * node.x + b * node.y + c * node.z).norm2sq();
+				weights += r.weights[k] / (r2 * std::sqrt(r2));
+			}
+			double scale = area / weights;
+			for (size_t k = 0; k < r.nodes.size(); ++k)
+			{
+				const FL3& node = r.nodes[k];
+				FL3 x = a * node.x + b * node.y + c * node.z;
+				double r2 = x.norm2sq();
+				double r1 = std::sqrt(r2);
+				kernel(x / r1, scale * r.weights[k] / (r2 * r1));
+			}
+		} break;
+		}
+	}
+
 	// A (spherical) polygon
 	class Polygon
 	{
@@ -405,6 +744,9 @@ namespace Cartosphere
 		// Check if a point is in the interior.
 		Relation interior(const Point& point) const;
 
+		// Obtain the list of vertices
+		const vector<Point>& vertices() const { return _V; }
+
 	public:
 		// Emplace a point using spherical coordinates
 		inline void emplace_back(double polar, double azimuth)
@@ -433,6 +775,56 @@ namespace Cartosphere
 	class TriangularMesh
 	{
 	public:
+		// Index of the redundant connectivity, 32-bit unless built with
+		// CARTOSPHERE_INDEX64 for meshes of more than 4 billion entries
+#ifdef CARTOSPHERE_INDEX64
+		typedef std::uint64_t Index;
+#else
+		typedef std::uint32_t Index;
+#endif
+		// Index of no entry, such as the face across a boundary edge
+		static constexpr Index NoIndex = (Index)-1;
+		// Vertices of a face, or faces across its edges
+		typedef std::array<Index, 3> IndexTriplet;
+		// Lists of indices compressed into one array (CSR)
+		// List i is items[offsets[i]] to items[offsets[i + 1] - 1]
+		class Adjacency
+		{
+		public:
+			// A view of one list
+			struct List
+			{
+				const Index* first;
+				const Index* last;
+				const Index* begin() const { return first; }
+				const Index* end() const { return last; }
+				size_t size() const { return last - first; }
+				Index operator[](size_t k) const { return first[k]; }
+			};
+
+		public:
+			// Number of lists
+			size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+			// Is empty?
+			bool empty() const { return size() == 0; }
+			// Obtain list i
+			List operator[](size_t i) const
+			{
+				return { items.data() + offsets[i], items.data() + offsets[i + 1] };
+			}
+			// Clear the lists
+			void clear() { offsets.clear(); items.clear(); }
+			// Build from pairs of list indices and items by a counting sort,
+			// which keeps the items of each list in their order of appearance
+			void build(size_t lists, const vector<Index>& keys,
+				const vector<Index>& values);
+
+		public:
+			// Start of each list, and the total count at the end
+			vector<Index> offsets;
+			// Concatenated lists
+			vector<Index> items;
+		};
 		// Pair of indices to points
 		typedef std::pair<size_t, size_t> UndirectedEdge;
 		// Edge index and its orientation
@@ -462,135 +854,145 @@ namespace Cartosphere
 			AreaWeighted,
 			DualAreaWeighted, // Weight values by area of dual polygons
 		};
-		// SSTree
+		// Base polyhedra of generated meshes
+		enum class Polyhedron {
+			Icosahedron,
+			Octahedron,
+		};
+		// Numberings of the vertices for locality
+		enum class Ordering {
+			Hilbert,      // Along a Hilbert curve through the unit cube
+			CuthillMcKee, // Reverse Cuthill-McKee on the edges
+		};
+		// SSTree, bulk-loaded top-down
 		class Tree
 		{
+			// The binary mesh format stores the nodes
+			friend class TriangularMesh;
+
+		public:
+			// Index returned when no triangle contains a point
+			static constexpr size_t npos = (size_t)-1;
+
 		protected:
 			// SSElem
-			class Node
+			struct Node
 			{
-			public:
-				// Type: Node Pointer
-				typedef shared_ptr<Node> Pointer;
-				// Type: Vector of pointers type
-				typedef vector<Pointer> Pointers;
-				// Why not?
-				static const size_t npos = (size_t)-1;
-
-			protected:
-				// Stores the parent
-				Pointer _parent;
-				// Stores the children
-				Pointers _children;
-				// Index of the triangle
-				size_t _index = npos;
-				// Number of nodes in the subtree (total number of children)
-				size_t _subtree = 0;
-				// The height above this node
-				size_t _height = 0;
-				// Update count without refresh values
-				size_t _updates = 0;
-				// The sum of squared distance
-				double _variance = 0;
-				// Circumcircle, containing the centroid and a radius (S2-metric)
-				Cap _cap;
-
-			public:
-				// Make a node
-				Node() = default;
-				// Make a node from an index and a circumcircle
-				Node(size_t index, const Cap& cap) : _index(index), _cap(cap) {}
-
-			public:
-				// Number of children
-				size_t degree() const { return _children.size(); }
-				// Height of node
-				size_t height() const { return _height; }
-				// Return parent
-				Pointer parent() const { return _parent; }
+				// Apex of the minimum enclosing cap of the subtree
+				FL3 apex;
+				// Cosine of its radius, -1 if the cap is not convex
+				double cos_radius = -1;
+				// Children in _nodes, or triangles in _entries for a leaf
+				size_t first = 0;
+				size_t count = 0;
 				// Is it a leaf?
-				bool isLeaf() const { return _children.empty(); }
-				// Is it a root?
-				bool isRoot() const { return _parent == nullptr; }
-				// Obtain a cap
-				const Cap& cap() const { return _cap; }
-				// Obtain all children
-				Pointers children() const { return _children; }
-				// Obtain pointer to first children
-				Pointers::const_iterator begin() const { return _children.begin(); }
-				// Obtain pointer to first children
-				Pointers::const_iterator end() const { return _children.end(); }
-
-			public:
-				// Update the children and the circumcircle
-				void update(const Node::Pointers& nodes)
-				{
-					_children = nodes;
-					vector<Cap> caps;
-					std::transform(_children.begin(), _children.end(), std::back_inserter(caps),
-						[](const Pointer& p) {
-							return p->cap();
-						}
-					);
-					_cap = Cap::circumscribe(caps.begin(), caps.end());
-				}
-
-			public:
-				// Accommodate an entry
-				void store(Node::Pointer n) { _children.push_back(n); }
+				bool leaf = true;
 			};
-			// Minimum number of children
-			static const size_t m = 2;
-			// Maximum number of children
-			static const size_t M = 80;
-			// Number of points to omit when forcing a reinsertion
-			static const size_t p = 32;
+			// Maximum number of children, also the leaf capacity
+			static const size_t M = 8;
 
 		public:
 			// Is empty?
-			bool empty() const;
-			// Index a triangle based on a point
-			size_t find(const Point& p) const;
+			bool empty() const { return _nodes.empty(); }
+			// Index a triangle of a mesh based on a point
+			size_t find(const Point& p, const TriangularMesh& mesh) const;
 			// Height of the tree
-			size_t height() const { return _root.height(); }
+			size_t height() const { return _height; }
+			// Number of nodes
+			size_t size() const { return _nodes.size(); }
 
 		public:
 			// Clear the tree
 			void clear();
-			// Build from triangles
-			void build(const vector<Triangle>& vt)
+			// Build from the triangles of a mesh
+			void build(const TriangularMesh& mesh);
+			// Follow a refinement of the mesh where face f has the children
+			// kf to kf + k - 1: the entries of every leaf become the children
+			// of each face, and the leaves that overflow are split
+			void refine(const TriangularMesh& mesh, size_t children = 4);
+
+		protected:
+			// Algorithm Split: bound a range of entries by a cap, then split it
+			// into up to M children along the axes of greatest variance
+			// A node that is already bounded may keep its cap
+			void _split(size_t node, size_t first, size_t last,
+				const vector<FL3>& centroids, const TriangularMesh& mesh,
+				size_t depth, bool bound = true);
+
+		protected:
+			// Nodes, the root first
+			vector<Node> _nodes;
+			// Triangle indices, grouped by leaf
+			vector<size_t> _entries;
+			// Number of levels
+			size_t _height = 0;
+		};
+		// A triangle of the mesh, viewed through its vertex indices
+		// Geometry for the finite elements is precomputed when populating
+		class Face
+		{
+		public:
+			// Construct a view of a face of a mesh
+			Face(const TriangularMesh& mesh, size_t index) :
+				_m(mesh), _i(index) {}
+
+		public:
+			// Obtain a vertex
+			const Point& vertex(size_t j) const { return _m._V[_m._FV[_i][j]]; }
+			// Copy the vertices into a triangle
+			Triangle triangle() const
 			{
-				// Clear the tree
-				clear();
-				// Insert the triangles into the tree one by one.
-				for (size_t i = 0; i < vt.size(); ++i)
-				{
-					insert(i, vt[i].circumcircle());
-				}
+				return Triangle(vertex(0), vertex(1), vertex(2));
 			}
-			// Insert a circumcircle with its index
-			void insert(size_t index, const Cap& cap)
+			// Area as a spherical triangle
+			double area() const { return _m._FA[_i]; }
+			// Pole of the edge opposite a vertex, pointing inwards
+			const FL3& pole(size_t j) const { return _m._FP[3 * _i + j]; }
+			// Check for point containment
+			bool contains(const Point& p) const
 			{
-				_insert(make_shared<Tree::Node>(index, cap));
+				return dot(pole(0), p) >= 0 && dot(pole(1), p) >= 0
+					&& dot(pole(2), p) >= 0;
+			}
+			// Compute the barycentric coordinates
+			FL3 barycentric(const Point& p) const;
+			// Calculate the location of the center of mass
+			Point centroid() const;
+			// Obtain a finite element without type erasure
+			Element basis(size_t j) const
+			{
+				return Element(pole(j), vertex(j).image());
+			}
+			// Obtain a gradient vector element
+			FL3 gradient(size_t j) const
+			{
+				return basis(j).gradient(vertex(j).image());
+			}
+			// Obtain a gradient vector element at an interior point
+			FL3 gradient(size_t j, const Point& p) const
+			{
+				return basis(j).gradient(p.image());
+			}
+			// Numerically integrate a scalar function
+			template<typename F>
+			double integrate(const F& f, Triangle::Integrator intr) const
+			{
+				return Triangle::integrate(vertex(0).image(), vertex(1).image(),
+					vertex(2).image(), area(), f, intr);
+			}
+			// Visit the quadrature nodes as kernel(x, w)
+			template<typename K>
+			void quadrature(const K& kernel, Triangle::Integrator intr) const
+			{
+				Triangle::quadrature(vertex(0).image(), vertex(1).image(),
+					vertex(2).image(), area(), kernel, intr);
 			}
 
 		protected:
-			// Algorithm Insert
-			void _insert(Node::Pointer n, size_t level = 0);
-			// Algorithm ChooseSubtree
-			Node::Pointer _choose(Node::Pointer n, size_t level = 0);
-			// Algorithm OverflowTreatment
-			bool _overflow(Node::Pointer n, size_t level = 0);
-			// Algorithm ReInsert
-			void _reinsert(Node::Pointer n);
-			// Algorithm Split
-			void _split(Node::Pointer n);
-
-		protected:
-			// Root node
-			Node _root;
-			// Overflow calls
-			vector<bool> _overflown;
+			// Mesh
+			const TriangularMesh& _m;
+			// Face index
+			size_t _i;
 		};
 
 	public:
@@ -618,10 +1020,15 @@ namespace Cartosphere
 		void clear();
 		// Load triangle
 		bool load(const Triangle& t);
-		// Load file from path
+		// Load file from path, in the binary format if it ends with .csmb
+		// A path such as icosa:7 or octa:3 generates the mesh instead
 		bool load(const string& path);
-		// Save mesh to file
-		bool save(const string& path) const;
+		// Generate a base polyhedron refined by mid-point refinement
+		// The refinement hierarchy from the base polyhedron is kept
+		bool generate(Polyhedron base, size_t level);
+		// Save mesh to file, in the binary format if it ends with .csmb
+		// The binary format also keeps the redundant states unless told not to
+		bool save(const string& path, bool redundant = true) const;
 		// Export mesh to OBJ format
 		bool format(const string& path,
 			const vector<double> &values = vector<double>()) const;
@@ -632,22 +1039,50 @@ namespace Cartosphere
 		void refine();
 		// Refine the mesh to a certain number of divisions
 		void refine(size_t division);
+		// Estimate the error of the nodal values in each face from the jumps
+		// of their normal derivatives across its edges
+		vector<double> estimate() const;
+		// Bisect faces by newest-vertex bisection, along with the faces
+		// needed to keep the mesh conforming
+		// Nodal values are interpolated at the new vertices
+		void bisect(const vector<size_t>& faces);
+		// Undo the bisections whose faces are all listed
+		// Nodal values at the removed vertices are dropped
+		void coarsen(const vector<size_t>& faces);
+		// Adapt the mesh to the nodal values: bisect the faces holding the
+		// fraction `refine` of the estimated error, and coarsen the faces
+		// holding together no more than the fraction `coarsen`
+		void adapt(double refine, double coarsen = 0);
+		// Renumber the vertices for locality, and the edges and faces by
+		// their new vertices; nodal values follow their vertices
+		// Returns the old index of each new vertex
+		vector<size_t> reorder(Ordering ordering = Ordering::Hilbert);
 		// Report the area of each triangle
 		void reportAreas();
 		// Compute the gradient field at the vertices
 		void set(const vector<double>& values);
+		// Get the nodal values
+		const vector<double>& values() const { return _a; }
 		// Interpolate the function value of a point
 		double interpolate(const Point& p) const;
 		// Interpolate the gradient value at a point
 		FL3 gradient(const Point& p) const;
+		// Interpolate the function value of a point, walking from a hint
+		// The hint is updated to the triangle containing the point
+		double interpolate(const Point& p, size_t& hint) const;
+		// Interpolate the gradient value at a point, walking from a hint
+		// The hint is updated to the triangle containing the point
+		FL3 gradient(const Point& p, size_t& hint) const;
 		// Numerically integrate a scalar function
 		double integrate(const Function& f,
 			Quadrature rule = Quadrature::AreaWeighted,
 			Triangle::Integrator intr = Triangle::DefaultIntegrator) const;
+		// Obtain a view of a triangle
+		Face face(size_t triangleIndex) const { return Face(*this, triangleIndex); }
 		// Return the index vertices of the triangles
 		UI3 indexTriangleVertices(size_t triangleIndex) const
 		{
-			vector<size_t> V = _FV[triangleIndex];
+			const IndexTriplet& V = _FV[triangleIndex];
 			UI3 index;
 			index.a = V[0];
 			index.b = V[1];
@@ -667,6 +1102,9 @@ namespace Cartosphere
 		// FEM: Generate inner products of finite elements and their gradients
 		void fill(SparseMatrixRowMajor& A, SparseMatrixRowMajor& M,
 			Triangle::Integrator intr = Triangle::DefaultIntegrator) const;
+		// FEM: Compute the local stiffness and mass matrices of a face
+		void local(size_t triangleIndex, double (&A)[3][3], double (&M)[3][3],
+			Triangle::Integrator intr = Triangle::DefaultIntegrator) const;
 		// FEM: Discretize an external force parametrized by x, y, and z.
 		void fill(ColVector& b, Function f,
 			Triangle::Integrator intr = Triangle::DefaultIntegrator) const;
@@ -677,14 +1115,104 @@ namespace Cartosphere
 		{
 			return _V;
 		}
+		// Return the vertices of a face
+		const IndexTriplet& faceVertices(size_t triangleIndex) const
+		{
+			return _FV[triangleIndex];
+		}
+		// Locate the triangle containing a point, by the SS-tree if indexed
+		size_t locate(const Point& p, bool indexed = true) const
+		{
+			return indexed ? _lookup_tree(p) : _lookup_linear(p);
+		}
+		// Locate the triangle containing a point by walking from a hint
+		// Falls back to the SS-tree if the hint is invalid or too far away
+		size_t walk(const Point& p, size_t hint) const;
+		// Locate the triangles containing points, walking from hints
+		// Hints are resized to match the points and updated in place
+		void locate(const vector<Point>& p, vector<size_t>& hints) const;
+		// Height of the SS-tree
+		size_t treeHeight() const { return _tree.height(); }
+		// Keep the refinement hierarchy from the current mesh downwards
+		// Refinement other than mid-point refinement discards it
+		void retainHierarchy(bool retain = true);
+		// Is the refinement hierarchy kept?
+		bool hasHierarchy() const { return _bHierarchy; }
+		// Number of mid-point refinements in the hierarchy
+		size_t hierarchyLevels() const { return _HV.size(); }
+		// Locate the triangle containing a point by descending the hierarchy
+		// Falls back to the SS-tree if the hierarchy is not kept
+		size_t descend(const Point& p) const;
+		// Hierarchical cell ID of a triangle: a marker bit followed by the
+		// base face and two bits per level for the child taken at each level
+		// The parent of a cell at a positive level is the ID shifted right by 2
+		std::uint64_t cell(size_t triangleIndex) const;
+		// FEM: Generate the prolongation from each level of the hierarchy to
+		// the next, coarsest first, interpolating at the edge midpoints
+		// Empty if the hierarchy is not kept
+		void prolongations(vector<SparseMatrixRowMajor>& P) const;
 
 	private:
+		// Split each face into four at the midpoints of its edges, updating
+		// the vertices, edges and faces, and the vertices and neighbours of
+		// each face; returns false if the faces were not populated
+		bool _subdivide();
+		// Keep the vertices of the current faces as a level of the hierarchy
+		void _retain_level();
 		// Refresh redundant states
 		void _populate();
+		// Refresh the vertices of each face and the faces across its edges
+		// Returns false if the edges of a face do not form a simplex
+		bool _populate_faces();
+		// Refresh the areas and poles of the faces
+		void _populate_geometry();
+		// Refresh the states derived from the vertices of each face: the
+		// faces and edges at each vertex, the colouring, and the sparsity
+		// pattern with its slots
+		void _populate_incidence();
 		// Compute the gradient given nodal values
 		void _gradient(const vector<double>& a);
+		// Bisect and coarsen the marked faces, then rebuild the mesh
+		void _adapt(const vector<char>& refine, const vector<char>& coarsen);
+		// Rebuild the edges and faces from the vertices of each face
+		// The directed edges of each face start at its vertices in order
+		void _connect(const vector<IndexTriplet>& faces);
+		// Compute the local stiffness matrix of a face
+		void _local_stiffness(size_t k, Triangle::Integrator intr,
+			double (&local)[3][3]) const;
+		// Compute the local mass matrix of a face
+		void _local_mass(size_t k, Triangle::Integrator intr,
+			double (&local)[3][3]) const;
+		// Scatter local matrices, one per face, into a global matrix
+		void _assemble(SparseMatrixRowMajor& A, const double (*L)[3][3]) const;
 		// Lookup triangle index from a point
 		size_t _lookup(const Point& p) const;
+		// Lookup triangle index from a point by the SS-tree
+		size_t _lookup_tree(const Point& p) const;
+		// Lookup triangle index from a point by a linear scan
+		size_t _lookup_linear(const Point& p) const;
+		// Interpolate the function value of a point in a given triangle
+		double _interpolate(const Point& p, size_t i) const;
+		// Interpolate the gradient value at a point in a given triangle
+		FL3 _gradient(const Point& p, size_t i) const;
+		// Load a binary mesh through a memory map
+		bool _load_binary(const string& path);
+		// Save a binary mesh
+		bool _save_binary(const string& path, bool redundant) const;
+		// Check that every index in the redundant state read from a binary
+		// mesh is in range, given the sparsity pattern it stores; returns
+		// the first problem found, or an empty string
+		string _check_redundant(const vector<int>& outer,
+			const vector<int>& inner) const;
+
+	private:
+		// Maximum number of edges crossed by a walk before giving up
+		static const size_t WalkSteps = 64;
+		// Identify binary mesh files ("CSMB" in little-endian)
+		static constexpr std::uint32_t BinaryMagic = 0x424d5343;
+		static constexpr std::uint32_t BinaryVersion = 1;
+		// Binary mesh flag: redundant states follow the faces
+		static constexpr std::uint32_t BinaryRedundant = 1;
 
 	private:
 		// Input data: List of points
@@ -693,26 +1221,46 @@ namespace Cartosphere
 		vector<UndirectedEdge> _E;
 		// Input data: List of faces (each a triplet of directed edge indices)
 		vector<DirectedEdgeTriplet> _F;
-		// Redundant state: List of triangles (owning coordinates)
-		vector<Triangle> _vt;
+		// Redundant state: Area of each face
+		vector<double> _FA;
+		// Redundant state: Poles of the edges opposite each vertex, three per
+		// face
+		vector<FL3> _FP;
 		// Redundant state: List of edges sharing a vertex
-		vector<vector<size_t>> _VE;
+		Adjacency _VE;
 		// Redundant state: List of faces sharing a vertex
-		vector<vector<size_t>> _VF;
+		Adjacency _VF;
 		// Redundant state: List of vertices in each face
-		vector<vector<size_t>> _FV;
+		vector<IndexTriplet> _FV;
+		// Redundant state: List of faces across the edge opposite each vertex
+		vector<IndexTriplet> _FF;
+		// Redundant state: Faces grouped by colour, sharing no vertex
+		Adjacency _FC;
+		// Redundant state: Zero-valued sparsity pattern of the FEM matrices
+		SparseMatrixRowMajor _pattern;
+		// Redundant state: Position in the pattern of each local matrix entry
+		vector<int> _slots;
+		// Hierarchy: Vertices of each face at coarser levels, three per face
+		// The children of face k are faces 4k to 4k+3 of the next level
+		vector<vector<Index>> _HV;
 		// State: Nodal values
 		vector<double> _a;
 		// State: gradient vectors
 		vector<FL3> _grad;
 		// State: SS-tree for lookup
-		// Tree _tree;
+		Tree _tree;
+		// Adaptivity: Endpoints of the edge bisected at each vertex
+		// Empty until the first adaptation, which rotates each face so that
+		// its first vertex is opposite the edge to bisect next
+		vector<std::array<Index, 2>> _VB;
 
 	private:
 		// File load flag
 		bool _bLoadSuccess = false;
 		// File parse flag
 		bool _bParseSuccess = false;
+		// Hierarchy flag
+		bool _bHierarchy = false;
 		// Messages
 		vector<string> _vInfo;
 	};
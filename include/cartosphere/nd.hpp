@@ -42,9 +42,9 @@ public:
 	// Add a vector
 	FL3& operator+=(FL3 const& b)
 	{
-		this->x -= b.x;
-		this->y -= b.y;
-		this->z -= b.z;
+		this->x += b.x;
+		this->y += b.y;
+		this->z += b.z;
 		return *this;
 	}
 
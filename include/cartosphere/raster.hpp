@@ -0,0 +1,88 @@
+
+#ifndef __RASTER_HPP__
+#define __RASTER_HPP__
+
+#include "cartosphere/mesh.hpp"
+
+namespace Cartosphere
+{
+	// Rasterizes valued regions onto the equiangular grid of SpectralGlobe
+	// Each grid cell receives the area-weighted average of the region values
+	// covering it, and the background value for the uncovered remainder
+	// Where regions overlap by more than the cell, their values are
+	// averaged by coverage alone
+	class Rasterizer
+	{
+	public:
+		// A region made of rings, combined by the even-odd rule
+		// Ring edges are straight lines in the (polar, azimuth) plane
+		typedef vector<Cartosphere::Polygon> Region;
+
+	public:
+		// Default constructor
+		Rasterizer() {}
+
+	public:
+		// Add a region with a value
+		void add(const Region& rings, double value);
+
+		// Add a single-ring region with a value
+		void add(const Cartosphere::Polygon& ring, double value);
+
+		// Remove all regions
+		void clear();
+
+		// Number of regions
+		size_t count() const { return _values.size(); }
+
+		// Fill the N x N grid (N = 2B) in row-major order
+		// Rows are polar rings, columns are azimuthal cells
+		void rasterize(int B, double* grid) const;
+
+	protected:
+		// An edge in the (polar, azimuth) plane
+		// The azimuth of the head is unwrapped relative to the tail
+		struct Edge
+		{
+			double p1, a1;
+			double p2, a2;
+		};
+
+		// Coverage of one region along a scanline at polar angle p
+		// Coverage is accumulated in units of cells with the given weight
+		// Returns false if the scanline misses the region entirely
+		bool _scan(size_t r, double p, double weight,
+			const vector<size_t>& edges, vector<double>& xs,
+			int N, double* coverage) const;
+
+	protected:
+		// Edges of each region
+		vector<vector<Edge>> _edges;
+
+		// Polar angles where each region crosses the azimuth 0, sorted
+		vector<vector<double>> _seams;
+
+		// Does the region contain the north pole?
+		vector<bool> _north;
+
+		// Value of each region
+		vector<double> _values;
+
+		// Value of the uncovered area
+		double _background = 0;
+
+		// Number of sub-scanlines per polar ring
+		int _subrings = 4;
+
+	public:
+		// Get/Set background
+		double get_background() const { return _background; }
+		void set_background(double v) { _background = v; }
+
+		// Get/Set subrings
+		int get_subrings() const { return _subrings; }
+		void set_subrings(int s) { if (s > 0) _subrings = s; }
+	};
+}
+
+#endif // !__RASTER_HPP__
@@ -51,4 +51,34 @@ int research_f();
 // Jan 24, 2023. Read shapefiles
 int research_g(const string &folder);
 
+/* Benchmark initial data: per-cell sampling vs rasterized regions */
+int benchmark_raster(int bandlimit = 512);
+
+/* Benchmark checkpoints: uninterrupted vs stopped and resumed transforms */
+int benchmark_resume(int bandlimit = 64);
+
+/* Benchmark point location: linear scan vs SS-tree */
+int benchmark_lookup(int levels = 6);
+
+/* Benchmark quadrature rules: refinement vs symmetric Gauss-type rules */
+int benchmark_quadrature(int level = 1);
+
+/* Benchmark adaptive refinement: uniform vs adaptive meshes */
+int benchmark_adapt(int levels = 6);
+
+/* Benchmark vertex numberings: bandwidth and SpMV throughput */
+int benchmark_reorder(int level = 7);
+
+/* Benchmark time stepping: cached LDLT vs conjugate gradients */
+int benchmark_factorization(int level = 6);
+
+/* Benchmark linear solvers: BiCGSTAB vs geometric multigrid */
+int benchmark_multigrid(int levels = 7);
+
+/* Benchmark FEM operators: assembled vs matrix-free */
+int benchmark_matrixfree(int level = 8);
+
+/* Benchmark time stepping: implicit vs lumped-mass explicit schemes */
+int benchmark_explicit(int level = 6);
+
 #endif // !__RESEARCH_HPP__
@@ -92,6 +92,9 @@ namespace Cartosphere
 		// Offloads all points into a single vector
 		vector<Cartosphere::Point> gather() const;
 
+		// Converts each polygon shape into rings of longitude/latitude points
+		vector<vector<Cartosphere::Polygon>> regions() const;
+
 		// Count number of shapes
 		size_t count() const { return shapes.size(); }
 
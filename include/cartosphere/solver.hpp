@@ -8,6 +8,248 @@
 
 namespace Cartosphere
 {
+	class FEMOperator;
+}
+
+namespace Eigen
+{
+	namespace internal
+	{
+		// The iterative solvers take the operator as a sparse matrix
+		template<>
+		struct traits<Cartosphere::FEMOperator> :
+			public traits<SparseMatrixColMajor>
+		{
+		};
+	}
+}
+
+namespace Cartosphere
+{
+	// The stiffness and mass matrices of a mesh, applied as cA A + cM M face
+	// by face from the local matrices, without assembling them
+	// Constants have no gradient, so the diagonal of A is the negated sum of
+	// the rest of its row; the mesh must outlive the operator
+	class FEMOperator : public Eigen::EigenBase<FEMOperator>
+	{
+	public:
+		typedef double Scalar;
+		typedef double RealScalar;
+		typedef int StorageIndex;
+		enum
+		{
+			ColsAtCompileTime = Eigen::Dynamic,
+			MaxColsAtCompileTime = Eigen::Dynamic,
+			IsRowMajor = false
+		};
+
+	public:
+		FEMOperator() = default;
+		// Compute the local matrices of each face
+		FEMOperator(const TriangularMesh& mesh,
+			Triangle::Integrator intr = Triangle::DefaultIntegrator);
+
+	public:
+		// Number of rows
+		Eigen::Index rows() const { return _rows; }
+		// Number of columns
+		Eigen::Index cols() const { return _rows; }
+		// Copy sharing the local matrices, applying cA A + cM M
+		FEMOperator scaled(double cA, double cM) const
+		{
+			FEMOperator op = *this;
+			op._cA = cA;
+			op._cM = cM;
+			return op;
+		}
+		// Copy sharing the local matrices, on a copy of the mesh
+		FEMOperator rebound(const TriangularMesh& mesh) const
+		{
+			FEMOperator op = *this;
+			op._mesh = _mesh ? &mesh : nullptr;
+			return op;
+		}
+		// Apply to x, overwriting y
+		void apply(const double* x, double* y) const;
+		// Diagonal of cA A + cM M
+		ColVector diagonal() const;
+		// Bytes held by the local matrices
+		size_t memory() const
+		{
+			return _locals ? _locals->size() * sizeof(_Local) : 0;
+		}
+		// Product with a vector, for the iterative solvers
+		template<typename Rhs>
+		Eigen::Product<FEMOperator, Rhs, Eigen::AliasFreeProduct>
+		operator*(const Eigen::MatrixBase<Rhs>& x) const
+		{
+			return Eigen::Product<FEMOperator, Rhs, Eigen::AliasFreeProduct>(
+				*this, x.derived());
+		}
+
+	private:
+		// Faces per chunk: chunks of consecutive faces are coloured, so each
+		// is applied in the order of the faces
+		static const size_t ChunkFaces = 1024;
+
+	private:
+		// Local matrices of a face: the off-diagonal entries 01, 12 and 20
+		// of A, and the lower triangle 00, 10, 11, 20, 21, 22 of M
+		struct _Local
+		{
+			double a[3];
+			double m[6];
+		};
+
+	private:
+		// Mesh providing the faces
+		const TriangularMesh* _mesh = nullptr;
+		// Local matrices of each face, shared by scaled copies
+		std::shared_ptr<const vector<_Local>> _locals;
+		// Chunks grouped by colour, sharing no vertex
+		TriangularMesh::Adjacency _chunks;
+		// Number of vertices
+		Eigen::Index _rows = 0;
+		// Coefficients of A and M
+		double _cA = 1, _cM = 0;
+	};
+
+	// Jacobi preconditioner for the iterative solvers, from the diagonal of
+	// an operator that provides it
+	class JacobiPreconditioner
+	{
+	public:
+		template<typename MatrixType>
+		JacobiPreconditioner& analyzePattern(const MatrixType&)
+		{
+			return *this;
+		}
+		template<typename MatrixType>
+		JacobiPreconditioner& factorize(const MatrixType& A)
+		{
+			_D = A.diagonal().cwiseInverse();
+			return *this;
+		}
+		template<typename MatrixType>
+		JacobiPreconditioner& compute(const MatrixType& A)
+		{
+			return factorize(A);
+		}
+		template<typename Rhs>
+		ColVector solve(const Eigen::MatrixBase<Rhs>& b) const
+		{
+			return _D.cwiseProduct(b);
+		}
+		Eigen::ComputationInfo info() const
+		{
+			return Eigen::Success;
+		}
+
+	private:
+		// Inverse diagonal
+		ColVector _D;
+	};
+
+	// Conjugate gradients with Jacobi on the matrix-free operator
+	using SolverMatrixFree = Eigen::ConjugateGradient<
+		FEMOperator, Eigen::Lower | Eigen::Upper, JacobiPreconditioner
+	>;
+}
+
+namespace Eigen
+{
+	namespace internal
+	{
+		// Product of the operator with a vector, as dst += alpha * lhs * rhs
+		template<typename Rhs>
+		struct generic_product_impl<Cartosphere::FEMOperator, Rhs,
+			SparseShape, DenseShape, GemvProduct> :
+			generic_product_impl_base<Cartosphere::FEMOperator, Rhs,
+				generic_product_impl<Cartosphere::FEMOperator, Rhs>>
+		{
+			typedef typename Product<Cartosphere::FEMOperator, Rhs>::Scalar Scalar;
+
+			template<typename Dest>
+			static void scaleAndAddTo(Dest& dst,
+				const Cartosphere::FEMOperator& lhs, const Rhs& rhs,
+				const Scalar& alpha)
+			{
+				Eigen::Ref<const ColVector> x(rhs);
+				ColVector y(lhs.rows());
+				lhs.apply(x.data(), y.data());
+				dst += alpha * y;
+			}
+		};
+	}
+}
+
+namespace Cartosphere
+{
+	// Geometric multigrid over the levels of a refinement hierarchy
+	class Multigrid
+	{
+	public:
+		// Corrections from the next coarser level at each level: one for a
+		// V-cycle, two for a W-cycle
+		enum class Cycle { V, W };
+
+		Multigrid() = default;
+		// The coarsest solver may refer to a matrix kept here
+		Multigrid(const Multigrid&) = delete;
+		Multigrid& operator=(const Multigrid&) = delete;
+
+	public:
+		// Set up the levels from the finest matrix and the prolongations
+		// from each level to the next, coarsest first
+		// Coarser matrices are the Galerkin products P^T A P
+		void compute(const SparseMatrixRowMajor& A,
+			const vector<SparseMatrixRowMajor>& P);
+		// Set the cycle
+		void set(Cycle cycle) { _cycle = cycle; }
+		// Set the Gauss-Seidel sweeps before and after each correction
+		void smoothing(size_t sweeps) { _sweeps = sweeps; }
+		// Set the relative residual at which solve stops
+		void tolerance(double tolerance) { _tolerance = tolerance; }
+		// Number of levels
+		size_t levels() const { return _A.size(); }
+		// Apply one cycle to the finest-level guess x
+		void cycle(const ColVector& b, ColVector& x) const;
+		// Solve by conjugate gradients preconditioned with one cycle per
+		// iteration, starting from x
+		// Returns the number of iterations
+		size_t solve(const ColVector& b, ColVector& x) const;
+
+	private:
+		// Apply one cycle at level l
+		void _cycle_level(size_t l, const ColVector& b, ColVector& x) const;
+		// Gauss-Seidel sweeps at level l, in increasing or decreasing order
+		void _smooth(size_t l, const ColVector& b, ColVector& x, bool forward) const;
+
+	private:
+		// Largest coarsest level that is solved by a dense factorisation
+		static const size_t DenseMaximum = 1024;
+		// Iterations after which solve gives up
+		static const size_t IterationsMaximum = 200;
+
+	private:
+		// Matrix of each level, coarsest first
+		vector<SparseMatrixRowMajor> _A;
+		// Prolongation from each level to the next
+		vector<SparseMatrixRowMajor> _P;
+		// Inverse diagonal of each level
+		vector<ColVector> _D;
+		// Coarsest level: dense factorisation, which also handles the
+		// constants in the kernel of the stiffness matrix
+		Eigen::CompleteOrthogonalDecomposition<Matrix> _dense;
+		// Coarsest level: conjugate gradients if too large to be dense
+		SparseMatrixColMajor _coarse;
+		SolverCG _cg;
+		// Settings
+		Cycle _cycle = Cycle::V;
+		size_t _sweeps = 2;
+		double _tolerance = 1e-10;
+	};
+
 	class SteadyStateSolver
 	{
 	public:
@@ -42,45 +284,118 @@ namespace Cartosphere
 	class TimeDependentSolver
 	{
 	public:
+		// Linear solvers for the symmetric systems of each step
+		enum class LinearSolver
+		{
+			// Sparse LDL^T factorisation, two triangular solves per step
+			LDLT,
+			// Conjugate gradients with incomplete Cholesky, warm-started
+			ConjugateGradient,
+			// Conjugate gradients with multigrid V-cycles, warm-started;
+			// needs the refinement hierarchy of the mesh
+			Multigrid,
+			// Conjugate gradients with Jacobi, warm-started, on the
+			// matrix-free operator; A and M are not assembled
+			MatrixFree
+		};
+
+		// Time integration schemes of advance
+		enum class Scheme
+		{
+			// Backward Euler, one linear solve per step
+			BackwardEuler,
+			// Forward Euler with the lumped mass matrix, in as many
+			// substeps as stability needs
+			ForwardEuler,
+			// Second-order Runge-Kutta-Legendre super time stepping with
+			// the lumped mass matrix, in as many stages as stability needs
+			RKL2
+		};
+
+		// Reuse of the cached systems
+		struct CacheStatistics
+		{
+			size_t hits = 0;
+			size_t misses = 0;
+			// Fraction of steps that reused a factorisation
+			double rate() const
+			{
+				return hits + misses ? double(hits) / (hits + misses) : 0;
+			}
+		};
+
+		TimeDependentSolver() = default;
+		// The matrix-free operator refers to the mesh held here, so copies
+		// rebind it to their own mesh and start without cached systems
+		TimeDependentSolver(const TimeDependentSolver& other)
+		{
+			_copy(other);
+		}
+		TimeDependentSolver& operator=(const TimeDependentSolver& other)
+		{
+			if (this != &other)
+			{
+				_copy(other);
+			}
+			return *this;
+		}
+
 		// Set mesh
 		void set(const TriangularMesh& m)
 		{
 			_m = m;
+			_build();
+			_v = _m.vertices();
+			_a = ColVector(_v.size());
+		}
 
-			// Build relevant matrices
-			_m.fill(_A, _M, Cartosphere::Triangle::Integrator::Refinement5);
-
-			// Attempt to correct the matrix A
-			for (int k = 0; k < _A.outerSize(); ++k)
+		// Set the linear solver, dropping the cached systems
+		// Switching to or from the matrix-free operator rebuilds the system
+		void set(LinearSolver solver)
+		{
+			bool rebuild = _a.size() > 0 &&
+				(solver == LinearSolver::MatrixFree) != (_solver == LinearSolver::MatrixFree);
+			_solver = solver;
+			_cache.clear();
+			if (rebuild)
 			{
-				SparseMatrixRowMajor::InnerIterator it_diag;
-				double sum_offdiag = 0;
-				for (SparseMatrixRowMajor::InnerIterator it(_A, k); it; ++it)
-				{
-					it.row();   // row index
-					it.col();   // col index (here it is equal to k)
+				_build();
+			}
+		}
 
-					// Locate the diagonal element or else accumulate
-					if (it.row() == it.col())
-					{
-						it_diag = it;
-					}
-					else
-					{
-						sum_offdiag += it.value();
-					}
-				}
-				it_diag.valueRef() = -sum_offdiag;
+		// Set the time integration scheme of advance
+		void set(Scheme scheme)
+		{
+			_scheme = scheme;
+		}
+
+		// Set how many distinct systems are kept factorised
+		void capacity(size_t n)
+		{
+			_capacity = std::max<size_t>(n, 1);
+			if (_cache.size() > _capacity)
+			{
+				_cache.resize(_capacity);
 			}
+		}
 
-			_a = ColVector(_A.cols());
-			_v = _m.vertices();
+		// Get the nodal values
+		const vector<double>& values() const
+		{
+			return _m.values();
+		}
+
+		// Get the reuse of the cached systems
+		const CacheStatistics& statistics() const
+		{
+			return _statistics;
 		}
 
 		// Set mesh
 		void set(Function f)
 		{
-			_m.fill(_b, f, Cartosphere::Triangle::Integrator::Refinement5);
+			_f = f;
+			_m.fill(_b, f, Cartosphere::Triangle::Integrator::Gauss6);
 		}
 
 		// Set mesh
@@ -89,14 +404,27 @@ namespace Cartosphere
 			std::transform(_v.begin(), _v.end(), _a.begin(), f);
 		}
 
-		// Advance using forward Euler.
+		// Adapt the mesh to the nodal values between steps, carrying them
+		// over to the new vertices; the matrices and the forcing are rebuilt
+		void adapt(double refine, double coarsen = 0);
+
+		// Advance using the scheme set, backward Euler by default
 		double advance(double timestep)
 		{
-			SparseMatrixRowMajor LHS = _A + _M / timestep;
-			ColVector RHS = _b + _M / timestep * _a;
-
-			SolverBiCGSTAB s(LHS);
-			ColVector a = s.solve(RHS);
+			ColVector a;
+			if (_scheme == Scheme::ForwardEuler)
+			{
+				a = _forward_euler(timestep);
+			}
+			else if (_scheme == Scheme::RKL2)
+			{
+				a = _rkl2(timestep);
+			}
+			else
+			{
+				ColVector RHS = _b + _product(0, 1 / timestep, _a);
+				a = _solve(1, 1 / timestep, RHS);
+			}
 
 			ColVector _aprev = _a;
 			_a = a;
@@ -124,21 +452,177 @@ namespace Cartosphere
 		// Advance using Crank-Nicolson.
 		double advanceCrankNicolson(double timestep);
 
+		// Largest stable timestep of forward Euler with the lumped mass
+		// matrix, 2 / rho(M_L^-1 A), from a power iteration
+		double stableTimestep();
+
+		// Stages of the last RKL2 step
+		size_t stages() const
+		{
+			return _stages;
+		}
+
 		// Velocity
 		vector<FL3> velocity(const vector<Point>& p) const;
 
+		// Velocity, locating points by walking from the triangles in hints
+		// Hints are resized to match the points and updated in place
+		vector<FL3> velocity(const vector<Point>& p, vector<size_t>& hints) const;
+
 	protected:
+		// Copy the state of another solver, except its cached systems
+		void _copy(const TimeDependentSolver& other);
+
+		// Build the matrices on the mesh, which invalidates the
+		// factorisations
+		void _build()
+		{
+			_m.prolongations(_P);
+			_cache.clear();
+			_radius = 0;
+
+			// The matrix-free operator keeps the local matrices instead
+			if (_solver == LinearSolver::MatrixFree)
+			{
+				_op = FEMOperator(_m, Cartosphere::Triangle::Integrator::Gauss6);
+				_A = SparseMatrixRowMajor();
+				_M = SparseMatrixRowMajor();
+			}
+			else
+			{
+				_op = FEMOperator();
+
+				// Build relevant matrices
+				_m.fill(_A, _M, Cartosphere::Triangle::Integrator::Gauss6);
+
+				// Attempt to correct the matrix A
+				for (int k = 0; k < _A.outerSize(); ++k)
+				{
+					SparseMatrixRowMajor::InnerIterator it_diag;
+					double sum_offdiag = 0;
+					for (SparseMatrixRowMajor::InnerIterator it(_A, k); it; ++it)
+					{
+						it.row();   // row index
+						it.col();   // col index (here it is equal to k)
+
+						// Locate the diagonal element or else accumulate
+						if (it.row() == it.col())
+						{
+							it_diag = it;
+						}
+						else
+						{
+							sum_offdiag += it.value();
+						}
+					}
+					it_diag.valueRef() = -sum_offdiag;
+				}
+			}
+
+			// Lump the mass matrix into its row sums
+			size_t V = _solver == LinearSolver::MatrixFree ? _op.rows() : _M.rows();
+			_lumped = _product(0, 1, ColVector::Ones(V));
+		}
+
+		// Apply cA A + cM M to x
+		ColVector _product(double cA, double cM, const ColVector& x) const
+		{
+			if (_solver == LinearSolver::MatrixFree)
+			{
+				return _op.scaled(cA, cM) * x;
+			}
+			ColVector y = ColVector::Zero(x.size());
+			if (cA != 0)
+			{
+				y += cA * (_A * x);
+			}
+			if (cM != 0)
+			{
+				y += cM * (_M * x);
+			}
+			return y;
+		}
+
+		// Rate of change M_L^-1 (b - A a) with the lumped mass matrix
+		ColVector _rate(const ColVector& a) const
+		{
+			return (_b - _product(1, 0, a)).cwiseQuotient(_lumped);
+		}
+
+		// Values after a step of forward Euler with the lumped mass matrix
+		ColVector _forward_euler(double timestep);
+
+		// Values after a step of RKL2 with the lumped mass matrix
+		ColVector _rkl2(double timestep);
+
+		// Solve (cA A + cM M) x = RHS, factorising the matrix only when
+		// the coefficients are not among the cached systems
+		ColVector _solve(double cA, double cM, const ColVector& RHS);
+
+		// Left-hand side cA A + cM M and its factorisation
+		struct _System
+		{
+			double cA, cM;
+			// Matrix referenced by the iterative solver
+			SparseMatrixColMajor LHS;
+			SolverLDLT ldlt;
+			SolverCG cg;
+			Cartosphere::Multigrid mg;
+			// Operator referenced by the matrix-free solver
+			FEMOperator op;
+			SolverMatrixFree mf;
+		};
+
+		// Power iterations estimating the spectral radius of M_L^-1 A
+		static const size_t PowerIterations = 30;
+
+		// Margin over the estimated spectral radius
+		static constexpr double RadiusMargin = 1.1;
+
 		// Finite-element Mesh
 		TriangularMesh _m;
 
+		// Factorised systems, most recently used first
+		vector<std::shared_ptr<const _System>> _cache;
+
+		// Number of systems kept factorised
+		size_t _capacity = 2;
+
+		// Linear solver for new systems
+		LinearSolver _solver = LinearSolver::LDLT;
+
+		// Reuse of the cached systems
+		CacheStatistics _statistics;
+
+		// Time integration scheme of advance
+		Scheme _scheme = Scheme::BackwardEuler;
+
+		// Lumped mass matrix, the row sums of M
+		ColVector _lumped;
+
+		// Spectral radius of M_L^-1 A, or 0 until estimated
+		double _radius = 0;
+
+		// Stages of the last RKL2 step
+		size_t _stages = 0;
+
 		// List of vertices
 		vector<Point> _v;
 
 		// Matrix for internal calculation
 		SparseMatrixRowMajor _A, _M;
 
+		// Matrix-free operator, in place of the matrices
+		FEMOperator _op;
+
+		// Prolongations between the levels of the refinement hierarchy
+		vector<SparseMatrixRowMajor> _P;
+
 		// Vectors for internal calculation
 		ColVector _b, _a;
+
+		// External force
+		Function _f;
 	};
 }
 
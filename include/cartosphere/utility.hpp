@@ -39,12 +39,17 @@ static const int ThreadsMaximum = omp_get_max_threads();
 #endif
 
 // Commonly used templates
+#include <array>
+#include <cstdint>
 #include <vector>
 using std::vector;
 
 #include <string>
 using std::string;
 
+#include <map>
+using std::map;
+
 #include <fstream>
 using std::ifstream;
 using std::ofstream;
@@ -61,6 +66,11 @@ using std::istringstream;
 #include <filesystem>
 using std::filesystem::path;
 
+// Concurrency
+#include <future>
+#include <mutex>
+#include <thread>
+
 // Timing
 #include <chrono>
 using std::chrono::steady_clock;
@@ -91,16 +101,29 @@ using SparseMatrixRowMajor = Eigen::SparseMatrix<double, Eigen::RowMajor>;
 // Provide convenient typedef for coordinates
 using SparseMatrixEntry = Eigen::Triplet<double>;
 
+// Import Eigen sparse matrix (column-major)
+using SparseMatrixColMajor = Eigen::SparseMatrix<double, Eigen::ColMajor>;
+
 #include <Eigen/IterativeLinearSolvers>
 using SolverBiCGSTAB = Eigen::BiCGSTAB<
 	SparseMatrixRowMajor, Eigen::IncompleteLUT<SparseMatrixRowMajor::Scalar>
 >;
+// Conjugate gradients with incomplete Cholesky, for symmetric systems
+using SolverCG = Eigen::ConjugateGradient<
+	SparseMatrixColMajor, Eigen::Lower | Eigen::Upper,
+	Eigen::IncompleteCholesky<SparseMatrixColMajor::Scalar>
+>;
+
+#include <Eigen/SparseCholesky>
+// Sparse LDL^T factorisation, for symmetric systems
+using SolverLDLT = Eigen::SimplicialLDLT<SparseMatrixColMajor>;
 #pragma warning(pop)
 
 // Numerics, algorithms, and functionals
 #include <numeric>
 #include <algorithm>
 #include <functional>
+#include <random>
 
 // Use glog to debug things
 // Windows output: %APPDATA%/../Local/Temp
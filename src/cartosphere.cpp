@@ -1,6 +1,7 @@
 
 #include "cartosphere/cartosphere.hpp"
 using Cartosphere::Point;
+using Cartosphere::PointCloud;
 using Cartosphere::SpectralGlobe;
 using Cartosphere::FiniteElementGlobe;
 
@@ -8,14 +9,79 @@ using Cartosphere::FiniteElementGlobe;
 
 void
 SpectralGlobe::initialize_solver()
+{
+	_allocate();
+	_reset();
+
+	// Initialize
+	if (B > 0)
+	{
+		if (init_regions.count() > 0)
+		{
+			// Rasterize regions by their area-weighted coverage
+			init_regions.rasterize(B, init_data.data());
+		}
+		else
+		{
+			// Sample initial condition
+			double phi, theta;
+			for (int j = 0; j < N; ++j)
+			{
+				theta = M_PI / N * (j + 0.5);
+				for (int k = 0; k < N; ++k)
+				{
+					phi = M_PI / B * (k + 0.5);
+					Point P(theta, phi);
+					init_data[N * j + k] = initFunction(P);
+				}
+			}
+		}
+
+		// Compute initial Fourier coefficients
+		cs_fds2ht(B, init_data.data(), init_hats.data(), ws2.data());
+	}
+}
+
+void
+SpectralGlobe::checkpoint_solver(vector<double>& payload) const
+{
+	// The bandlimit followed by the Fourier coefficients at time 0
+	payload.clear();
+	payload.reserve(1 + init_hats.size());
+	payload.push_back(B);
+	payload.insert(payload.end(), init_hats.begin(), init_hats.end());
+}
+
+bool
+SpectralGlobe::restore_solver(const vector<double>& payload)
+{
+	if (payload.empty())
+	{
+		return false;
+	}
+	int b = (int)payload[0];
+	if (b <= 0 || payload.size() != 1 + (size_t)b * b)
+	{
+		return false;
+	}
+
+	// Skip sampling and cs_fds2ht altogether
+	B = b;
+	_allocate();
+	_reset();
+	std::copy(payload.begin() + 1, payload.end(), init_hats.begin());
+	return true;
+}
+
+void
+SpectralGlobe::_allocate()
 {
 	// B is treated as the NEW bandlimit
 	// N is treated as twice the OLD bandlimit
 	int n = B * 2;
 
-	// If B==0, deallocate, reset
-	// If B!=0 and n==N, reset, initialize
-	// If B!=0 and n!=N, deallocate, allocate, reset, initialize
+	// If B==0, deallocate
+	// If B!=0 and n!=N, deallocate, allocate
 	if (B == 0 || n != N)
 	{
 		// Deallocate
@@ -26,11 +92,14 @@ SpectralGlobe::initialize_solver()
 		N = n;
 		// Resize
 		init_data.resize(N * N);
-		time_data.resize(N * N);
 		init_hats.resize(B * B);
-		time_hats.resize(B * B);
-		time_dp.resize(N * N);
-		time_da.resize(N* N);
+		for (Field* field : { &time_field, &next_field })
+		{
+			field->hats.resize(B * B);
+			field->data.resize(N * N);
+			field->dp.resize(N * N);
+			field->da.resize(N * N);
+		}
 		// Allocate
 		if (B > 0)
 		{
@@ -40,30 +109,17 @@ SpectralGlobe::initialize_solver()
 			cs_ids2ht_plans(B, ipad, &idct, &idst);
 		}
 	}
-	
-	// Reset
+}
+
+void
+SpectralGlobe::_reset()
+{
 	history.clear();
-	time_data_north = time_data_south = 0;
-	time_grad_north = time_grad_south = { 0, 0, 0 };
-	
-	// Initialize
-	if (B > 0)
+	cache.clear();
+	for (Field* field : { &time_field, &next_field })
 	{
-		// Sample initial condition
-		double phi, theta;
-		for (int j = 0; j < N; ++j)
-		{
-			theta = M_PI / N * (j + 0.5);
-			for (int k = 0; k < N; ++k)
-			{
-				phi = M_PI / B * (k + 0.5);
-				Point P(theta, phi);
-				init_data[N * j + k] = initFunction(P);
-			}
-		}
-
-		// Compute initial Fourier coefficients
-		cs_fds2ht(B, init_data.data(), init_hats.data(), ws2.data());
+		field->data_north = field->data_south = 0;
+		field->grad_north = field->grad_south = { 0, 0, 0 };
 	}
 }
 
@@ -85,29 +141,133 @@ SpectralGlobe::cleanup()
 		fftw_destroy_plan(idst);
 		idst = NULL;
 	}
+	_cleanup_batch();
+}
+
+void
+SpectralGlobe::_cleanup_batch()
+{
+	if (bpad != nullptr)
+	{
+		fftw_free(bpad);
+		bpad = nullptr;
+	}
+	if (bidct != NULL)
+	{
+		fftw_destroy_plan(bidct);
+		bidct = NULL;
+	}
+	if (bidst != NULL)
+	{
+		fftw_destroy_plan(bidst);
+		bidst = NULL;
+	}
+	bcount = 0;
 }
 
 void
 SpectralGlobe::advance_solver(double time, double delta)
 {
 	// Interval: [0, t]
-	double t = time + delta;
+	_fetch(time + delta, time_field);
+}
 
-	double* H = time_hats.data();
-	double* D = time_data.data();
-	double* P[2] = { time_dp.data(), time_da.data() };
-	double* W = ws2.data();
-	
-	// Compute decayed coefficients
-	for (int l = 0; l < B; ++l)
+void
+SpectralGlobe::prefetch_solver(double time, double delta)
+{
+	// Interval: [0, t], kept aside until swap_solver
+	_fetch(time + delta, next_field);
+}
+
+void
+SpectralGlobe::swap_solver()
+{
+	std::swap(time_field, next_field);
+}
+
+void
+SpectralGlobe::prepare_solver(const vector<double>& times)
+{
+	// Only synthesize the time levels not already cached
+	vector<double> missing;
+	for (double t : times)
 	{
-		int eigenvalue = -l * (l + 1);
-		for (int m = -l; m <= l; ++m)
+		if (cache.find(t) == cache.end())
 		{
-			int i = cs_index2(B, l, m);
-			H[i] = init_hats[i] * exp(eigenvalue * t);
+			missing.push_back(t);
 		}
 	}
+	int count = (int)missing.size();
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Re-plan the batched transforms whenever the batch size changes
+	if (count != bcount)
+	{
+		_cleanup_batch();
+		bcount = count;
+		bpad = fftw_alloc_real(count * N * N * 2);
+		cs_ids2ht_plans_many(B, count, bpad, &bidct, &bidst);
+	}
+
+	// Compute decayed coefficients for every time level
+	vector<double> H(count * B * B);
+	for (int b = 0; b < count; ++b)
+	{
+		_decay(missing[b], H.data() + B * B * b);
+	}
+
+	// Compute homogenized data and partials for all time levels at once
+	vector<double> D(count * N * N), P(count * N * N), A(count * N * N);
+	double* W = ws2.data();
+	cs_ids2ht_many(B, count, H.data(), D.data(), W, bpad, bidct, bidst);
+	cs_ids2ht_dp_many(B, count, H.data(), P.data(), W, bpad, bidct, bidst);
+	cs_ids2ht_da_many(B, count, H.data(), A.data(), W, bpad, bidct, bidst);
+
+	// Split the batch into fields
+	for (int b = 0; b < count; ++b)
+	{
+		Field& field = cache[missing[b]];
+		field.hats.assign(H.begin() + B * B * b, H.begin() + B * B * (b + 1));
+		field.data.assign(D.begin() + N * N * b, D.begin() + N * N * (b + 1));
+		field.dp.assign(P.begin() + N * N * b, P.begin() + N * N * (b + 1));
+		field.da.assign(A.begin() + N * N * b, A.begin() + N * N * (b + 1));
+		_poles(field);
+	}
+}
+
+void
+SpectralGlobe::_fetch(double t, Field& field)
+{
+	auto iter = cache.find(t);
+	if (iter == cache.end())
+	{
+		_synthesize(t, field);
+	}
+	else if (replay)
+	{
+		// Keep the cached field for the next transform
+		field = iter->second;
+	}
+	else
+	{
+		field = std::move(iter->second);
+		cache.erase(iter);
+	}
+}
+
+void
+SpectralGlobe::_synthesize(double t, Field& field)
+{
+	double* H = field.hats.data();
+	double* D = field.data.data();
+	double* P[2] = { field.dp.data(), field.da.data() };
+	double* W = ws2.data();
+	
+	// Compute decayed coefficients
+	_decay(t, H);
 
 	// Compute homogenized data
 	cs_ids2ht(B, H, D, W, ipad, idct, idst);
@@ -117,17 +277,39 @@ SpectralGlobe::advance_solver(double time, double delta)
 	cs_ids2ht_da(B, H, P[1], W, ipad, idct, idst);
 
 	// Compute data and velocities at the poles
-	time_data_north = 0;
-	time_data_south = 0;
+	_poles(field);
+}
+
+void
+SpectralGlobe::_decay(double t, double* hats) const
+{
+	for (int l = 0; l < B; ++l)
+	{
+		int eigenvalue = -l * (l + 1);
+		for (int m = -l; m <= l; ++m)
+		{
+			int i = cs_index2(B, l, m);
+			hats[i] = init_hats[i] * exp(eigenvalue * t);
+		}
+	}
+}
+
+void
+SpectralGlobe::_poles(Field& field) const
+{
+	const double* P[2] = { field.dp.data(), field.da.data() };
+
+	field.data_north = 0;
+	field.data_south = 0;
 	for (int l = 0; l < B; ++l)
 	{
 		double q_l = sqrt((l + 0.5) / (2 * M_PI));
-		double q_hat_l = q_l * time_hats[cs_index2(B, l, 0)];
-		time_data_north += q_hat_l;
-		time_data_south += ((l % 2) ? -1 : 1) * q_hat_l;
+		double q_hat_l = q_l * field.hats[cs_index2(B, l, 0)];
+		field.data_north += q_hat_l;
+		field.data_south += ((l % 2) ? -1 : 1) * q_hat_l;
 	}
-	time_grad_north = { 0, 0, 0 };
-	time_grad_south = { 0, 0, 0 };
+	field.grad_north = { 0, 0, 0 };
+	field.grad_south = { 0, 0, 0 };
 	{
 		double phi, cos_phi, sin_phi;
 		double sin_theta = sin(M_PI / N * 0.5);
@@ -137,18 +319,63 @@ SpectralGlobe::advance_solver(double time, double delta)
 			phi = M_PI / B * (k + 0.5);
 			cos_phi = cos(phi);
 			sin_phi = sin(phi);
-			time_grad_north.x += P[0][k] * cos_phi - P[1][k] * sin_phi / sin_theta;
-			time_grad_north.y += P[0][k] * sin_phi + P[1][k] * cos_phi / sin_theta;
-			time_grad_south.x += -P[0][offset + k] * cos_phi - P[1][offset + k] * sin_phi / sin_theta;
-			time_grad_south.y += -P[0][offset + k] * sin_phi + P[1][offset + k] * cos_phi / sin_theta;
+			field.grad_north.x += P[0][k] * cos_phi - P[1][k] * sin_phi / sin_theta;
+			field.grad_north.y += P[0][k] * sin_phi + P[1][k] * cos_phi / sin_theta;
+			field.grad_south.x += -P[0][offset + k] * cos_phi - P[1][offset + k] * sin_phi / sin_theta;
+			field.grad_south.y += -P[0][offset + k] * sin_phi + P[1][offset + k] * cos_phi / sin_theta;
 		}
 	}
-	time_grad_north /= N;
-	time_grad_south /= N;
+	field.grad_north /= N;
+	field.grad_south /= N;
 }
 
 void
 SpectralGlobe::velocity(const vector<Point>& points, vector<FL3>& velocities) const
+{
+	_log_grids();
+
+	// Calculate the j, k index of the cell that contains each point
+	// Then compute the velocity based on the shape of the cell
+	for (int i = 0; i < points.size(); ++i)
+	{
+		const Point& P = points[i];
+		velocities[i] = _velocity(P.p(), P.a(),
+			cos(P.p()), sin(P.p()), cos(P.a()), sin(P.a()));
+	}
+}
+
+void
+SpectralGlobe::velocity(const PointCloud& points, vector<FL3>& velocities) const
+{
+	_log_grids();
+
+	// The cell lookup needs the angles, but the change of basis only needs
+	// their trigs, which are recovered from the Cartesian coordinates
+	points.refresh();
+	int n = (int)points.size();
+#pragma omp parallel for if (n >= 4096) num_threads(ThreadsMaximum)
+	for (int i = 0; i < n; ++i)
+	{
+		double x = points.x(i), y = points.y(i), z = points.z(i);
+		double theta = points.p(i), phi = points.a(i);
+		double sin_theta = sqrt(x * x + y * y);
+		double cos_phi, sin_phi;
+		if (sin_theta > DoubleEpsilon)
+		{
+			cos_phi = x / sin_theta;
+			sin_phi = y / sin_theta;
+		}
+		else
+		{
+			cos_phi = cos(phi);
+			sin_phi = sin(phi);
+		}
+		velocities[i] = _velocity(theta, phi, z, sin_theta, cos_phi, sin_phi);
+	}
+}
+
+void
+SpectralGlobe::_log_grids() const
 {
 	// Prepare for logging
 	Eigen::IOFormat OctaveFmt(Eigen::StreamPrecision, 0, ", ", ";\n", "", "", "[", "]");
@@ -156,152 +383,145 @@ SpectralGlobe::velocity(const vector<Point>& points, vector<FL3>& velocities) co
 	if (FLAGS_minloglevel == 0)
 	{
 		LOG(INFO) << "SpectralGlobe::velocity partial_theta\n"
-			<< Eigen::Map<const MatrixRowMajor>(time_dp.data(), N, N).format(OctaveFmt);
+			<< Eigen::Map<const MatrixRowMajor>(time_field.dp.data(), N, N).format(OctaveFmt);
 		LOG(INFO) << "SpectralGlobe::velocity partial_phi\n"
-			<< Eigen::Map<const MatrixRowMajor>(time_da.data(), N, N).format(OctaveFmt);
+			<< Eigen::Map<const MatrixRowMajor>(time_field.da.data(), N, N).format(OctaveFmt);
 	}
 
 	if (FLAGS_minloglevel == 0)
 	{
 		stringstream sst;
 		sst << "SpectralGlobe::velocity time_grad\n"
-			<< "  NORTH: [" << time_grad_north.x << ", "
-			<< time_grad_north.y << ", " << time_grad_north.z << "]" << "\n"
-			<< "  SOUTH: [" << time_grad_south.x << ", "
-			<< time_grad_south.y << ", " << time_grad_south.z << "]";
+			<< "  NORTH: [" << time_field.grad_north.x << ", "
+			<< time_field.grad_north.y << ", " << time_field.grad_north.z << "]" << "\n"
+			<< "  SOUTH: [" << time_field.grad_south.x << ", "
+			<< time_field.grad_south.y << ", " << time_field.grad_south.z << "]";
 		LOG(INFO) << sst.str();
 	}
+}
 
-	// Calculate the j, k index of the cell that contains each point
-	// Then compute the velocity based on the shape of the cell
-	for (int i = 0; i < points.size(); ++i)
+FL3
+SpectralGlobe::_velocity(double theta, double phi,
+	double cos_theta, double sin_theta, double cos_phi, double sin_phi) const
+{
+	// Compute the fractional j, k indices aligned with cell centers
+	double j_frac = theta * N * M_1_PI - 0.5;
+	double k_frac = phi * B * M_1_PI - 0.5;
+	if (k_frac < 0)
 	{
-		const Point& P = points[i];
-
-		// Compute the fractional j, k indices aligned with cell centers
-		double j_frac = P.p() * N * M_1_PI - 0.5;
-		double k_frac = P.a() * B * M_1_PI - 0.5;
-		if (k_frac < 0)
-		{
-			k_frac += N;
-		}
+		k_frac += N;
+	}
 
-		// Compute whole j, k indices aligned with cell centers
-		int j_n = (int)floor(j_frac);
-		int j_s = (j_n + 1);
-		int k_w = (int)floor(k_frac) % N;
-		int k_e = (k_w + 1) % N;
-		int NW, NE, SW, SE;
+	// Compute whole j, k indices aligned with cell centers
+	int j_n = (int)floor(j_frac);
+	int j_s = (j_n + 1);
+	int k_w = (int)floor(k_frac) % N;
+	int k_e = (k_w + 1) % N;
+	int NW, NE, SW, SE;
 
-		// Compute remainder coordinates for later bilinear interpolation
-		j_frac -= j_n;
-		k_frac -= k_w;
+	// Compute remainder coordinates for later bilinear interpolation
+	j_frac -= j_n;
+	k_frac -= k_w;
 
-		double data_north, sin_north, dp_north, da_north;
-		// Northern spherical cap
-		if (j_n == -1)
-		{
-			// Mark using magic numbers that the northern edge is degenerate
-			NW = -1;
-			NE = -1;
-			sin_north = 0;
-			// Scale j_frac from [0.5,1] to [0,1]
-			j_frac = 2 * j_frac - 1;
-			// Pick data from the north pole
-			data_north = time_data_north;
-			// Convert the gradient at the north pole into local coordinates
-			double azimuth = M_PI / B * k_e;
-			// Compute component along unit tangent at the north pole
-			FL3 basis_theta = {cos(azimuth), sin(azimuth), 0};
-			dp_north = dot(time_grad_north, basis_theta);
-			// Compute component along unit normal at the north pole
-			FL3 basis_phi = {-sin(azimuth), cos(azimuth), 0};
-			da_north = dot(time_grad_north, basis_phi);
-		}
-		// Northern edge is non-degenerate
-		else
-		{
-			// Compute the index of the northwest and northeast nodes
-			NW = N * j_n + k_w;
-			NE = N * j_n + k_e;
-			sin_north = sin(M_PI / N * (j_n + 0.5));
-			// Perform linear interpolation along the northern edge
-			data_north = (1 - k_frac) * time_data[NW] + k_frac * time_data[NE];
-			dp_north = (1 - k_frac) * time_dp[NW] + k_frac * time_dp[NE];
-			da_north = (1 - k_frac) * time_da[NW] + k_frac * time_da[NE];
-		}
+	double data_north, sin_north, dp_north, da_north;
+	// Northern spherical cap
+	if (j_n == -1)
+	{
+		// Mark using magic numbers that the northern edge is degenerate
+		NW = -1;
+		NE = -1;
+		sin_north = 0;
+		// Scale j_frac from [0.5,1] to [0,1]
+		j_frac = 2 * j_frac - 1;
+		// Pick data from the north pole
+		data_north = time_field.data_north;
+		// Convert the gradient at the north pole into local coordinates
+		double azimuth = M_PI / B * k_e;
+		// Compute component along unit tangent at the north pole
+		FL3 basis_theta = {cos(azimuth), sin(azimuth), 0};
+		dp_north = dot(time_field.grad_north, basis_theta);
+		// Compute component along unit normal at the north pole
+		FL3 basis_phi = {-sin(azimuth), cos(azimuth), 0};
+		da_north = dot(time_field.grad_north, basis_phi);
+	}
+	// Northern edge is non-degenerate
+	else
+	{
+		// Compute the index of the northwest and northeast nodes
+		NW = N * j_n + k_w;
+		NE = N * j_n + k_e;
+		sin_north = sin(M_PI / N * (j_n + 0.5));
+		// Perform linear interpolation along the northern edge
+		data_north = (1 - k_frac) * time_field.data[NW] + k_frac * time_field.data[NE];
+		dp_north = (1 - k_frac) * time_field.dp[NW] + k_frac * time_field.dp[NE];
+		da_north = (1 - k_frac) * time_field.da[NW] + k_frac * time_field.da[NE];
+	}
 
-		double data_south, sin_south, dp_south, da_south;
-		// Southern spherical cap
-		if (j_s == N)
-		{
-			// Mark using magic numbers that the southern edge is degenerate
-			SW = -1;
-			SE = -1;
-			sin_south = 0;
-			// Scale j_frac from [0,0.5] to [0,1]
-			j_frac = 2 * j_frac;
-			// Pick data from the south pole
-			data_south = time_data_south;
-			// Convert the gradient at the south pole into local coordinates
-			double azimuth = M_PI / B * k_e;
-			// Compute component along unit tangent at the south pole
-			FL3 basis_theta = {-cos(azimuth), -sin(azimuth), 0};
-			dp_south = dot(time_grad_south, basis_theta);
-			// Compute component along unit normal at the south pole
-			FL3 basis_phi = {-sin(azimuth), cos(azimuth), 0};
-			da_south = dot(time_grad_south, basis_phi);
-		}
-		// Southern edge is non-degenerate
-		else
-		{
-			// Compute the index of the southwest and southeast nodes
-			SW = N * j_s + k_w;
-			SE = N * j_s + k_e;
-			sin_south = sin(M_PI / N * (j_s + 0.5));
-			// Perform linear interpolation along the southern edge
-			data_south = (1 - k_frac) * time_data[SW] + k_frac * time_data[SE];
-			dp_south = (1 - k_frac) * time_dp[SW] + k_frac * time_dp[SE];
-			da_south = (1 - k_frac) * time_da[SW] + k_frac * time_da[SE];
-		}
+	double data_south, sin_south, dp_south, da_south;
+	// Southern spherical cap
+	if (j_s == N)
+	{
+		// Mark using magic numbers that the southern edge is degenerate
+		SW = -1;
+		SE = -1;
+		sin_south = 0;
+		// Scale j_frac from [0,0.5] to [0,1]
+		j_frac = 2 * j_frac;
+		// Pick data from the south pole
+		data_south = time_field.data_south;
+		// Convert the gradient at the south pole into local coordinates
+		double azimuth = M_PI / B * k_e;
+		// Compute component along unit tangent at the south pole
+		FL3 basis_theta = {-cos(azimuth), -sin(azimuth), 0};
+		dp_south = dot(time_field.grad_south, basis_theta);
+		// Compute component along unit normal at the south pole
+		FL3 basis_phi = {-sin(azimuth), cos(azimuth), 0};
+		da_south = dot(time_field.grad_south, basis_phi);
+	}
+	// Southern edge is non-degenerate
+	else
+	{
+		// Compute the index of the southwest and southeast nodes
+		SW = N * j_s + k_w;
+		SE = N * j_s + k_e;
+		sin_south = sin(M_PI / N * (j_s + 0.5));
+		// Perform linear interpolation along the southern edge
+		data_south = (1 - k_frac) * time_field.data[SW] + k_frac * time_field.data[SE];
+		dp_south = (1 - k_frac) * time_field.dp[SW] + k_frac * time_field.dp[SE];
+		da_south = (1 - k_frac) * time_field.da[SW] + k_frac * time_field.da[SE];
+	}
 
-		// Complete the bilinear interpolation for data and gradient components
-		// along the local basis
-		double data = (1 - j_frac) * data_north + j_frac * data_south;
-		double u = (1 - j_frac) * dp_north + j_frac * dp_south;
-		double v = 0;
-		if (sin_north == 0)
-		{
-			v += (1 - j_frac) * da_north;
-		}
-		else
-		{
-			v += (1 - j_frac) * da_north / sin_north;
-		}
-		if (sin_south == 0)
-		{
-			v += j_frac * da_south;
-		}
-		else
-		{
-			v += j_frac * da_south / sin_south;
-		}
+	// Complete the bilinear interpolation for data and gradient components
+	// along the local basis
+	double data = (1 - j_frac) * data_north + j_frac * data_south;
+	double u = (1 - j_frac) * dp_north + j_frac * dp_south;
+	double v = 0;
+	if (sin_north == 0)
+	{
+		v += (1 - j_frac) * da_north;
+	}
+	else
+	{
+		v += (1 - j_frac) * da_north / sin_north;
+	}
+	if (sin_south == 0)
+	{
+		v += j_frac * da_south;
+	}
+	else
+	{
+		v += j_frac * da_south / sin_south;
+	}
 
-		// Turn u e_theta + v e_phi into cartesian coordinates
-		FL3 grad;
-		{
-			double cos_theta = cos(P.p());
-			double sin_theta = sin(P.p());
-			double cos_phi = cos(P.a());
-			double sin_phi = sin(P.a());
-			// Convert gradient!
-			grad.x = u * cos_theta * cos_phi - v * sin_phi;
-			grad.y = u * cos_theta * sin_phi + v * cos_phi;
-			grad.z = u * (-sin_theta);
-		}
-		// Compute the velocity
-		velocities[i] = -grad / data;
+	// Turn u e_theta + v e_phi into cartesian coordinates
+	FL3 grad;
+	{
+		grad.x = u * cos_theta * cos_phi - v * sin_phi;
+		grad.y = u * cos_theta * sin_phi + v * cos_phi;
+		grad.z = u * (-sin_theta);
 	}
+	// Compute the velocity
+	return -grad / data;
 }
 
 void
@@ -180,11 +180,6 @@ void
 cs_ids2ht(int B, const double* harmonics, double* data, const double* ws2,
 	fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst)
 {
-	int N = 2 * B;
-
-	// Prepare for logging
-	Eigen::IOFormat OctaveFmt(Eigen::StreamPrecision, 0, ", ", ";\n", "", "", "[", "]");
-
 	if (FLAGS_minloglevel == 0)
 	{
 		LOG(INFO) << "cs_ids2ht print harmonics per format";
@@ -208,197 +203,234 @@ cs_ids2ht(int B, const double* harmonics, double* data, const double* ws2,
 		}
 	}
 
+	cs_ids2ht_many(B, 1, harmonics, data, ws2, pad, many_idct, many_idst);
+}
+
+void
+cs_ids2ht_dp(int B, const double* harmonics, double* partials, const double* ws2,
+	fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst)
+{
+	cs_ids2ht_dp_many(B, 1, harmonics, partials, ws2, pad, many_idct, many_idst);
+}
+
+void
+cs_ids2ht_da(int B, const double* harmonics, double* partials, const double* ws2,
+	fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst)
+{
+	cs_ids2ht_da_many(B, 1, harmonics, partials, ws2, pad, many_idct, many_idst);
+}
+
+void
+cs_ids2ht_many(int B, int count, const double* harmonics, double* data,
+	const double* ws2, fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst)
+{
+	int N = 2 * B;
+
 	// Clear output data and the entire scratchpad
-	memset(data, 0, N * N * sizeof(double));
-	memset(pad, 0, N * N * 2 * sizeof(double));
+	memset(data, 0, count * N * N * sizeof(double));
+	memset(pad, 0, count * N * N * 2 * sizeof(double));
 
 	// Compute 1D fourier coefficients for the northern hemisphere first
 	// Cosine and sine coefficients are interwoven in the same matrix!
-	// The structure of the scratchpad:
+	// The structure of the scratchpad for each set of harmonics:
 	//      +-----+-----+-----+-----+
 	//      | NxB | NxB | NxB | NxB |
 	//      | amj | cos | bmj | sin |
 	//      +-----+-----+-----+-----+
-#pragma omp parallel for if (B >= 128) num_threads(ThreadsMaximum)
+	// Each x_{j}-file is fetched once and applied to every set of harmonics
+#pragma omp parallel for if (B * count >= 128) num_threads(ThreadsMaximum)
 	for (int j = 0; j < N; ++j)
 	{
-		fftw_real* amj = pad + (2 * N * j);
-		fftw_real* bmj = amj + N;
 		// Retrieve renormalized P_{l,m} per x_{j}-file
 		// This file is already in upper triangular form
 		auto rePlmCos = cs_ws2_rePlmCosFile(B, j, ws2);
-		// Compute the cosine coefficients
-		for (int m = 0; m < B; ++m, ++amj)
+		for (int b = 0; b < count; ++b)
 		{
-			// Compute element-wise product between...
-			// 1: ROW m of UPPER TRIANGLE of HARMONICS
-			// 2: ROW m of UPPER TRIANGLE rePlmCosFile for x_{j}
-			auto row1 = harmonics + cs_index2(B, m, m);
-			auto row2 = rePlmCos + cs_index2_assoc(B, m, m);
-			for (int l = m; l < B; ++l)
+			auto hats = harmonics + B * B * b;
+			fftw_real* amj = pad + 2 * N * (N * b + j);
+			fftw_real* bmj = amj + N;
+			// Compute the cosine coefficients
+			for (int m = 0; m < B; ++m, ++amj)
 			{
-				*amj += row1[l - m] * row2[l - m];
+				// Compute element-wise product between...
+				// 1: ROW m of UPPER TRIANGLE of HARMONICS
+				// 2: ROW m of UPPER TRIANGLE rePlmCosFile for x_{j}
+				auto row1 = hats + cs_index2(B, m, m);
+				auto row2 = rePlmCos + cs_index2_assoc(B, m, m);
+				for (int l = m; l < B; ++l)
+				{
+					*amj += row1[l - m] * row2[l - m];
+				}
 			}
-		}
-		// Compute the sine coefficients
-		for (int m = 1; m < B; ++m, ++bmj)
-		{
-			// Compute element-wise product between...
-			// 1: ROW B-m of LOWER TRIANGLE of HARMONICS, shifted by m
-			// 2: ROW   m of UPPER TRIANGLE rePlmCosFile for x_{j}
-			auto row1 = harmonics + cs_index2(B, m, -m);
-			auto row2 = rePlmCos + cs_index2_assoc(B, m, m);
-			for (int l = m; l < B; ++l)
+			// Compute the sine coefficients
+			for (int m = 1; m < B; ++m, ++bmj)
 			{
-				*bmj += row1[l - m] * row2[l - m];
+				// Compute element-wise product between...
+				// 1: ROW B-m of LOWER TRIANGLE of HARMONICS, shifted by m
+				// 2: ROW   m of UPPER TRIANGLE rePlmCosFile for x_{j}
+				auto row1 = hats + cs_index2(B, m, -m);
+				auto row2 = rePlmCos + cs_index2_assoc(B, m, m);
+				for (int l = m; l < B; ++l)
+				{
+					*bmj += row1[l - m] * row2[l - m];
+				}
 			}
+			// Zero out the final sine coefficient
+			*bmj++ = 0;
 		}
-		// Zero out the final sine coefficient
-		*bmj++ = 0;
 	}
 
 	// Turn coefficients into data
 	if (FLAGS_minloglevel == 0)
 	{
-		LOG(INFO) << "cs_ids2ht invokes cs_ids2ht_execute";
+		LOG(INFO) << "cs_ids2ht_many invokes cs_ids2ht_execute_many";
 	}
-	cs_ids2ht_execute(B, pad, data, many_idct, many_idst);
+	cs_ids2ht_execute_many(B, count, pad, data, many_idct, many_idst);
 }
 
 void
-cs_ids2ht_dp(int B, const double* harmonics, double* partials, const double* ws2,
-	fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst)
+cs_ids2ht_dp_many(int B, int count, const double* harmonics, double* partials,
+	const double* ws2, fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst)
 {
 	int N = 2 * B;
 
-	// Prepare for logging
-	Eigen::IOFormat OctaveFmt(Eigen::StreamPrecision, 0, ", ", ";\n", "", "", "[", "]");
-
 	// Clear output data and the entire scratchpad
-	memset(partials, 0, N * N * sizeof(double));
-	memset(pad, 0, N * N * 2 * sizeof(double));
+	memset(partials, 0, count * N * N * sizeof(double));
+	memset(pad, 0, count * N * N * 2 * sizeof(double));
 
 	// Compute 1D fourier coefficients for the northern hemisphere
 	// The cs_ids2ht_execute will run two passes of idct & idst, and between
 	// the two passes, the Coefficients will be modified to account for the
 	// southern hemisphere
-#pragma omp parallel for if (B >= 128) num_threads(ThreadsMaximum)
+#pragma omp parallel for if (B * count >= 128) num_threads(ThreadsMaximum)
 	for (int j = 0; j < N; ++j)
 	{
-		fftw_real* amj = pad + (2 * N * j);
-		fftw_real* bmj = amj + N;
 		// Retrieve d~P_{l,m} per x_{j}-file
 		// This file is already in upper triangular form
 		auto drePlmCos = cs_ws2_drePlmCosFile(B, j, ws2);
-		// Compute the cosine coefficients
-		for (int m = 0; m < B; ++m, ++amj)
+		for (int b = 0; b < count; ++b)
 		{
-			// Compute element-wise product between...
-			// 1: ROW m of UPPER TRIANGLE of HARMONICS
-			// 2: ROW m of UPPER TRIANGLE drePlmCosFile for x_{j}
-			auto row1 = harmonics + cs_index2(B, m, m);
-			auto row2 = drePlmCos + cs_index2_assoc(B, m, m);
-			for (int l = m; l < B; ++l)
+			auto hats = harmonics + B * B * b;
+			fftw_real* amj = pad + 2 * N * (N * b + j);
+			fftw_real* bmj = amj + N;
+			// Compute the cosine coefficients
+			for (int m = 0; m < B; ++m, ++amj)
 			{
-				*amj += row1[l - m] * row2[l - m];
+				// Compute element-wise product between...
+				// 1: ROW m of UPPER TRIANGLE of HARMONICS
+				// 2: ROW m of UPPER TRIANGLE drePlmCosFile for x_{j}
+				auto row1 = hats + cs_index2(B, m, m);
+				auto row2 = drePlmCos + cs_index2_assoc(B, m, m);
+				for (int l = m; l < B; ++l)
+				{
+					*amj += row1[l - m] * row2[l - m];
+				}
 			}
-		}
-		// Compute the sine coefficients
-		for (int m = 1; m < B; ++m, ++bmj)
-		{
-			// Compute element-wise product between...
-			// 1: ROW B-m of LOWER TRIANGLE of HARMONICS, shifted by m
-			// 2: ROW   m of UPPER TRIANGLE drePlmCosFile for x_{j}
-			auto row1 = harmonics + cs_index2(B, m, -m);
-			auto row2 = drePlmCos + cs_index2_assoc(B, m, m);
-			for (int l = m; l < B; ++l)
+			// Compute the sine coefficients
+			for (int m = 1; m < B; ++m, ++bmj)
 			{
-				*bmj += row1[l - m] * row2[l - m];
+				// Compute element-wise product between...
+				// 1: ROW B-m of LOWER TRIANGLE of HARMONICS, shifted by m
+				// 2: ROW   m of UPPER TRIANGLE drePlmCosFile for x_{j}
+				auto row1 = hats + cs_index2(B, m, -m);
+				auto row2 = drePlmCos + cs_index2_assoc(B, m, m);
+				for (int l = m; l < B; ++l)
+				{
+					*bmj += row1[l - m] * row2[l - m];
+				}
 			}
+			// Zero out the final sine coefficient
+			*bmj++ = 0;
 		}
-		// Zero out the final sine coefficient
-		*bmj++ = 0;
 	}
 
 	// Turn coefficients into partials
 	if (FLAGS_minloglevel == 0)
 	{
-		LOG(INFO) << "cs_ids2ht_dp invokes cs_ids2ht_execute";
+		LOG(INFO) << "cs_ids2ht_dp_many invokes cs_ids2ht_execute_many";
 	}
-	cs_ids2ht_execute(B, pad, partials, many_idct, many_idst);
+	cs_ids2ht_execute_many(B, count, pad, partials, many_idct, many_idst);
 }
 
 void
-cs_ids2ht_da(int B, const double* harmonics, double* partials, const double* ws2,
-	fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst)
+cs_ids2ht_da_many(int B, int count, const double* harmonics, double* partials,
+	const double* ws2, fftw_real* pad, fftw_plan many_idct, fftw_plan many_idst)
 {
 	int N = 2 * B;
 
-	// Prepare for logging
-	Eigen::IOFormat OctaveFmt(Eigen::StreamPrecision, 0, ", ", ";\n", "", "", "[", "]");
-
 	// Clear output data and the entire scratchpad
-	memset(partials, 0, N * N * sizeof(double));
-	memset(pad, 0, N * N * 2 * sizeof(double));
+	memset(partials, 0, count * N * N * sizeof(double));
+	memset(pad, 0, count * N * N * 2 * sizeof(double));
 
 	// Compute 1D fourier coefficients for the northern hemisphere
 	// The cs_ids2ht_execute will run two passes of idct & idst, and between
 	// the two passes, the Coefficients will be modified to account for the
 	// southern hemisphere
-#pragma omp parallel for if (B >= 128) num_threads(ThreadsMaximum)
+#pragma omp parallel for if (B * count >= 128) num_threads(ThreadsMaximum)
 	for (int j = 0; j < N; ++j)
 	{
-		fftw_real* amj = pad + (2 * N * j);
-		fftw_real* bmj = amj + N;
 		// Retrieve P_{l,m} per x_{j}-file
 		// This file is already in upper triangular form
 		// Unlike the polar derivatives, the derivatives aren't needed here!
 		auto rePlmCos = cs_ws2_rePlmCosFile(B, j, ws2);
-		// Compute the cosine coefficients
-		// Note that in this partial derivative, nothing contributes to a_{0}
-		*amj++ = 0;
-		for (int m = 1; m < B; ++m, ++amj)
+		for (int b = 0; b < count; ++b)
 		{
-			// Compute element-wise product between...
-			// 1: ROW B-m of LOWER TRIANGLE of HARMONICS, shifted by m
-			// 2: ROW   m of UPPER TRIANGLE rePlmCosFile for x_{j}
-			auto row1 = harmonics + cs_index2(B, m, -m);
-			auto row2 = rePlmCos + cs_index2_assoc(B, m, m);
-			for (int l = m; l < B; ++l)
+			auto hats = harmonics + B * B * b;
+			fftw_real* amj = pad + 2 * N * (N * b + j);
+			fftw_real* bmj = amj + N;
+			// Compute the cosine coefficients
+			// Note that in this partial derivative, nothing contributes to a_{0}
+			*amj++ = 0;
+			for (int m = 1; m < B; ++m, ++amj)
 			{
-				// Extra m due to partial derivative w.r.t. phi
-				*amj += m * row1[l - m] * row2[l - m];
+				// Compute element-wise product between...
+				// 1: ROW B-m of LOWER TRIANGLE of HARMONICS, shifted by m
+				// 2: ROW   m of UPPER TRIANGLE rePlmCosFile for x_{j}
+				auto row1 = hats + cs_index2(B, m, -m);
+				auto row2 = rePlmCos + cs_index2_assoc(B, m, m);
+				for (int l = m; l < B; ++l)
+				{
+					// Extra m due to partial derivative w.r.t. phi
+					*amj += m * row1[l - m] * row2[l - m];
+				}
 			}
-		}
-		// Compute the sine coefficients
-		for (int m = 1; m < B; ++m, ++bmj)
-		{
-			// Compute element-wise product between...
-			// 1: ROW m of UPPER TRIANGLE of HARMONICS
-			// 2: ROW m of UPPER TRIANGLE rePlmCosFile for x_{j}
-			auto row1 = harmonics + cs_index2(B, m, m);
-			auto row2 = rePlmCos + cs_index2_assoc(B, m, m);
-			for (int l = m; l < B; ++l)
+			// Compute the sine coefficients
+			for (int m = 1; m < B; ++m, ++bmj)
 			{
-				// Extra -m due to partial derivative w.r.t. phi
-				*bmj += (-m) * row1[l - m] * row2[l - m];
+				// Compute element-wise product between...
+				// 1: ROW m of UPPER TRIANGLE of HARMONICS
+				// 2: ROW m of UPPER TRIANGLE rePlmCosFile for x_{j}
+				auto row1 = hats + cs_index2(B, m, m);
+				auto row2 = rePlmCos + cs_index2_assoc(B, m, m);
+				for (int l = m; l < B; ++l)
+				{
+					// Extra -m due to partial derivative w.r.t. phi
+					*bmj += (-m) * row1[l - m] * row2[l - m];
+				}
 			}
+			// Zero out the final sine coefficient
+			*bmj++ = 0;
 		}
-		// Zero out the final sine coefficient
-		*bmj++ = 0;
 	}
 
 	// Turn coefficients into partials
 	if (FLAGS_minloglevel == 0)
 	{
-		LOG(INFO) << "cs_ids2ht_da invokes cs_ids2ht_execute";
+		LOG(INFO) << "cs_ids2ht_da_many invokes cs_ids2ht_execute_many";
 	}
-	cs_ids2ht_execute(B, pad, partials, many_idct, many_idst);
+	cs_ids2ht_execute_many(B, count, pad, partials, many_idct, many_idst);
 }
 
 void
 cs_ids2ht_plans(int B,
 	fftw_real* pad, fftw_plan* ptr_many_idct, fftw_plan* ptr_many_idst)
+{
+	cs_ids2ht_plans_many(B, 1, pad, ptr_many_idct, ptr_many_idst);
+}
+
+void
+cs_ids2ht_plans_many(int B, int count,
+	fftw_real* pad, fftw_plan* ptr_many_idct, fftw_plan* ptr_many_idst)
 {
 	int N = 2 * B;
 
@@ -407,8 +439,8 @@ cs_ids2ht_plans(int B,
 	int rank = 1;
 	// ... of input length B
 	int n[] = { B };
-	// ... for N batches
-	int howmany = { N };
+	// ... for N batches per set of harmonics
+	int howmany = { N * count };
 
 	// The first input element is at
 	fftw_real* in = pad;
@@ -450,16 +482,26 @@ cs_ids2ht_plans(int B,
 void
 cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	fftw_plan many_idct, fftw_plan many_idst)
+{
+	cs_ids2ht_execute_many(B, 1, pad, data, many_idct, many_idst);
+}
+
+void
+cs_ids2ht_execute_many(int B, int count, fftw_real* pad, fftw_real* data,
+	fftw_plan many_idct, fftw_plan many_idst)
 {
 	int N = 2 * B;
 
+	// Consecutive sets of harmonics simply continue the rows of the pad
+	int rows = N * count;
+
 	// Prepare for logging
 	Eigen::IOFormat OctaveFmt(Eigen::StreamPrecision, 0, ", ", ";\n", "", "", "[", "]");
 
 	if (FLAGS_minloglevel == 0)
 	{
 		LOG(INFO) << "DCT-III coefficients\n";
-		for (int j = 0; j < N; ++j)
+		for (int j = 0; j < rows; ++j)
 		{
 			stringstream sst;
 			sst << "\t";
@@ -475,7 +517,7 @@ cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	if (FLAGS_minloglevel == 0)
 	{
 		LOG(INFO) << "DST-III coefficients\n";
-		for (int j = 0; j < N; ++j)
+		for (int j = 0; j < rows; ++j)
 		{
 			stringstream sst;
 			sst << "\t";
@@ -490,7 +532,7 @@ cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	}
 
 	// Account for normalization (FFTW to C++17)
-	for (int j = 0; j < N; ++j)
+	for (int j = 0; j < rows; ++j)
 	{
 		// All DCT-III coefficients with m != 0 must be divided by 2
 		auto* target = pad + (2 * N * j + 1);
@@ -509,7 +551,7 @@ cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	// Perform D{C,S}T-III
 	fftw_execute(many_idct); fftw_execute(many_idst);
 	// Copy results to the eastern hemisphere
-	for (int j = 0; j < N; ++j)
+	for (int j = 0; j < rows; ++j)
 	{
 		// Aggregate data due to DCT-III
 		auto* target = data + (N * j);
@@ -530,7 +572,7 @@ cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	if (FLAGS_minloglevel == 0)
 	{
 		LOG(INFO) << "Cosine contributions\n";
-		for (int j = 0; j < N; ++j)
+		for (int j = 0; j < rows; ++j)
 		{
 			LOG(INFO) << "\t"
 				<< "a_{" << j << ",:} = "
@@ -540,7 +582,7 @@ cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	if (FLAGS_minloglevel == 0)
 	{
 		LOG(INFO) << "Sine contributions\n";
-		for (int j = 0; j < N; ++j)
+		for (int j = 0; j < rows; ++j)
 		{
 			LOG(INFO) << "\t"
 				<< "b_{" << j << ",:} = "
@@ -549,7 +591,7 @@ cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	}
 
 	// Tune coefficients for the western hemisphere
-	for (int j = 0; j < N; ++j)
+	for (int j = 0; j < rows; ++j)
 	{
 		// For every two DCT-III columns, negate the second
 		auto* target = pad + (2 * N * j + 1);
@@ -567,7 +609,7 @@ cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	// Perform D{C,S}T-III
 	fftw_execute(many_idct); fftw_execute(many_idst);
 	// Copy results to the western hemisphere
-	for (int j = 0; j < N; ++j)
+	for (int j = 0; j < rows; ++j)
 	{
 		// Aggregate data due to DCT-III
 		auto* target = data + (N * j + B);
@@ -588,7 +630,7 @@ cs_ids2ht_execute(int B, fftw_real* pad, fftw_real* data,
 	if (FLAGS_minloglevel == 0)
 	{
 		LOG(INFO) << "Synthesized Data";
-		for (int j = 0; j < N; ++j)
+		for (int j = 0; j < rows; ++j)
 		{
 			LOG(INFO) << "\t"
 				<< "b_{" << j << ",:} = "
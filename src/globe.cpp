@@ -13,9 +13,9 @@ Globe::Globe(const string& path)
 		return;
 
 	// Fill in the following items
-	vector<string> names;
-	vector<double> values;
-	vector<Polygon> polygons;
+	vector<string>& names = _names;
+	vector<double>& values = _values;
+	vector<Polygon>& polygons = _polygons;
 
 	// Read then parse the file line by line
 	string line;
@@ -77,7 +77,7 @@ Globe::Globe(const string& path)
 				double polar, azimuth;
 				sst >> polar >> azimuth;
 				polar = cs_deg2rad(polar);
-				azimuth = cs_deg2rad(polar);
+				azimuth = cs_deg2rad(azimuth);
 				polygon.emplace_back(polar, azimuth);
 			}
 			else if (token == "XYZ")
@@ -90,7 +90,7 @@ Globe::Globe(const string& path)
 	}
 
 	// Create the mesh
-	_m.load("icosahedron.5.csm");
+	_m.generate(Cartosphere::TriangularMesh::Polyhedron::Icosahedron, 5);
 
 	// Find if vertex is in polygon.
 	// vector<Point> v = _m.vertices();
@@ -112,7 +112,7 @@ main(int argc, char* argv[])
 		.default_value(string{ "shapefile" })
 		.metavar("INFMT");
 	transformCmd.add_argument("-m", "--mesh")
-		.help("Set background mesh for FEM")
+		.help("Set background mesh for FEM: a mesh file, or icosa:LEVEL or octa:LEVEL")
 		.nargs(1)
 		.metavar("CSMFILE");
 	transformCmd.add_argument("-b", "--bandlimit")
@@ -262,11 +262,43 @@ main(int argc, char* argv[])
 		{
 			auto meshPath = transformCmd.get<string>("--mesh");
 			std::cout << "Mesh specified: " << meshPath << "\n";
-			std::cout << "Invoking FEM implementation...\n";
-			FiniteElementGlobe solver;
 
-			solver.transform(points);
-			std::exit(0);
+			// Generated meshes are named by their base and level; level 13
+			// is the last whose edges fit 32-bit indices
+			const int MaxLevel = 13;
+			Cartosphere::TriangularMesh mesh;
+			size_t colon = meshPath.find(':');
+			string base = meshPath.substr(0, colon);
+			if (colon != string::npos && (base == "icosa" || base == "octa"))
+			{
+				string level = meshPath.substr(colon + 1);
+				if (level.empty() || level.size() > 2 ||
+					level.find_first_not_of("0123456789") != string::npos ||
+					std::stoi(level) > MaxLevel)
+				{
+					std::cerr << "Mesh level must be from 0 to " << MaxLevel << ".\n";
+					std::exit(1);
+				}
+				mesh.generate(base == "icosa"
+					? Cartosphere::TriangularMesh::Polyhedron::Icosahedron
+					: Cartosphere::TriangularMesh::Polyhedron::Octahedron,
+					std::stoi(level));
+			}
+			else
+			{
+				mesh.load(meshPath);
+			}
+			if (!mesh.isReady())
+			{
+				std::cerr << "Cannot load mesh " << meshPath << "\n";
+				std::exit(1);
+			}
+
+			// FiniteElementGlobe does not compute velocities yet, so the
+			// transform would leave every point where it is
+			std::cout << "Invoking FEM implementation...\n";
+			std::cerr << "The FEM implementation cannot transform yet.\n";
+			std::exit(1);
 		}
 		else
 		{
@@ -641,6 +673,126 @@ runDemo(const string& name, const vector<string>& args)
 		return precompute_weights(path);
 	}
 
+	if (name == "raster")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int bandlimit = args.empty() ? 512 : std::stoi(args[0]);
+		return benchmark_raster(bandlimit);
+	}
+
+	if (name == "resume")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int bandlimit = args.empty() ? 64 : std::stoi(args[0]);
+		return benchmark_resume(bandlimit);
+	}
+
+	if (name == "lookup")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int levels = args.empty() ? 6 : std::stoi(args[0]);
+		return benchmark_lookup(levels);
+	}
+
+	if (name == "rules")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int level = args.empty() ? 1 : std::stoi(args[0]);
+		return benchmark_quadrature(level);
+	}
+
+	if (name == "adapt")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int levels = args.empty() ? 6 : std::stoi(args[0]);
+		return benchmark_adapt(levels);
+	}
+
+	if (name == "reorder")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int level = args.empty() ? 7 : std::stoi(args[0]);
+		return benchmark_reorder(level);
+	}
+
+	if (name == "factor")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int level = args.empty() ? 6 : std::stoi(args[0]);
+		return benchmark_factorization(level);
+	}
+
+	if (name == "multigrid")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int levels = args.empty() ? 7 : std::stoi(args[0]);
+		return benchmark_multigrid(levels);
+	}
+
+	if (name == "matrixfree")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int level = args.empty() ? 8 : std::stoi(args[0]);
+		return benchmark_matrixfree(level);
+	}
+
+	if (name == "explicit")
+	{
+		if (args.size() > 1)
+		{
+			std::cerr << "Needs at most 1 demo argument.\n";
+			std::exit(1);
+		}
+
+		int level = args.empty() ? 6 : std::stoi(args[0]);
+		return benchmark_explicit(level);
+	}
+
 	if (name == "refine")
 	{
 		if (args.size() != 1)
@@ -723,6 +875,16 @@ runDemo(const string& name, const vector<string>& args)
 		<< "quadrature         [---]\n"
 		<< "testobj            [---]\n"
 		<< "precompute         [---]\n"
+		<< "raster [BANDLIMIT] [Benchmark rasterized initial data]\n"
+		<< "resume [BANDLIMIT] [Benchmark checkpoint and resume]\n"
+		<< "lookup [LEVELS]    [Benchmark point location]\n"
+		<< "rules [LEVEL]      [Benchmark quadrature rules]\n"
+		<< "adapt [LEVELS]     [Benchmark adaptive refinement]\n"
+		<< "reorder [LEVEL]    [Benchmark vertex numberings]\n"
+		<< "factor [LEVEL]     [Benchmark cached factorisations]\n"
+		<< "multigrid [LEVELS] [Benchmark geometric multigrid]\n"
+		<< "matrixfree [LEVEL] [Benchmark matrix-free operators]\n"
+		<< "explicit [LEVEL]   [Benchmark explicit time stepping]\n"
 		<< "refine LEVEL       [---]\n"
 		<< "A                  [Research A]\n"
 		<< "B                  [Research B]\n"
@@ -3,6 +3,15 @@
 
 #include "cartosphere/functions.hpp"
 
+#include <charconv>
+#include <cstring>
+#ifdef APPLE_LIKE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 /* *************************** *
  * class Cartosphere::Preimage *
  * *************************** */
@@ -129,6 +138,150 @@ Cartosphere::midpoint(const Point& a, const Point& b)
 	return Point(Image(middleofChord));
 }
 
+/* ***************************** *
+ * class Cartosphere::PointCloud *
+ * ***************************** */
+Cartosphere::Point
+Cartosphere::PointCloud::point(size_t i) const
+{
+	return Point(image(i));
+}
+
+vector<Cartosphere::Point>
+Cartosphere::PointCloud::points() const
+{
+	vector<Point> points;
+	points.reserve(size());
+	for (size_t i = 0; i < size(); ++i)
+	{
+		points.push_back(point(i));
+	}
+	return points;
+}
+
+void
+Cartosphere::PointCloud::assign(const vector<Point>& points)
+{
+	size_t n = points.size();
+	_x.resize(n);
+	_y.resize(n);
+	_z.resize(n);
+	_p.resize(n);
+	_a.resize(n);
+
+	// The points already carry their preimages, so the cache starts valid
+	for (size_t i = 0; i < n; ++i)
+	{
+		_x[i] = points[i].x();
+		_y[i] = points[i].y();
+		_z[i] = points[i].z();
+		_p[i] = points[i].p();
+		_a[i] = points[i].a();
+	}
+	_bPreimageReady = true;
+}
+
+void
+Cartosphere::PointCloud::assign(vector<double> x, vector<double> y, vector<double> z)
+{
+	_x = std::move(x);
+	_y = std::move(y);
+	_z = std::move(z);
+	_bPreimageReady = false;
+}
+
+void
+Cartosphere::PointCloud::clear()
+{
+	_x.clear();
+	_y.clear();
+	_z.clear();
+	_p.clear();
+	_a.clear();
+	_bPreimageReady = false;
+}
+
+void
+Cartosphere::PointCloud::set(size_t i, const Image& image)
+{
+	_x[i] = image.x;
+	_y[i] = image.y;
+	_z[i] = image.z;
+	_bPreimageReady = false;
+}
+
+void
+Cartosphere::PointCloud::move(const vector<FL3>& displacements, double scale)
+{
+	// Follow the great circle through each point tangent to its displacement,
+	// equivalent to Point::move but without converting to spherical angles
+	double* X = _x.data();
+	double* Y = _y.data();
+	double* Z = _z.data();
+	const FL3* U = displacements.data();
+	int n = (int)size();
+#pragma omp parallel for if (n >= 4096) num_threads(ThreadsMaximum)
+	for (int i = 0; i < n; ++i)
+	{
+		double ux = U[i].x * scale;
+		double uy = U[i].y * scale;
+		double uz = U[i].z * scale;
+		// Length of the arc to travel
+		double length = sqrt(ux * ux + uy * uy + uz * uz);
+		// Project the displacement onto the tangent plane to obtain the
+		// direction of travel
+		double radial = X[i] * ux + Y[i] * uy + Z[i] * uz;
+		double tx = ux - radial * X[i];
+		double ty = uy - radial * Y[i];
+		double tz = uz - radial * Z[i];
+		double norm = sqrt(tx * tx + ty * ty + tz * tz);
+		// Degenerate displacements leave the point in place
+		if (!(norm > 0))
+		{
+			continue;
+		}
+		double c = cos(length);
+		double s = sin(length) / norm;
+		double x = X[i] * c + tx * s;
+		double y = Y[i] * c + ty * s;
+		double z = Z[i] * c + tz * s;
+		// Rescale onto the unit sphere so rounding does not drift over steps
+		double r = 1 / sqrt(x * x + y * y + z * z);
+		X[i] = x * r;
+		Y[i] = y * r;
+		Z[i] = z * r;
+	}
+	_bPreimageReady = false;
+}
+
+void
+Cartosphere::PointCloud::refresh() const
+{
+	if (_bPreimageReady)
+	{
+		return;
+	}
+
+	_p.resize(size());
+	_a.resize(size());
+	int n = (int)size();
+#pragma omp parallel for if (n >= 4096) num_threads(ThreadsMaximum)
+	for (int i = 0; i < n; ++i)
+	{
+		// Same convention as Image::to_preimage, clamped against rounding
+		_p[i] = acos(std::clamp(_z[i], -1.0, 1.0));
+		if (abs(_x[i]) + abs(_y[i]) > DoubleEpsilon)
+		{
+			_a[i] = atan2(_y[i], _x[i]);
+		}
+		else
+		{
+			_a[i] = 0;
+		}
+	}
+	_bPreimageReady = true;
+}
+
 /* *************************** *
  * class Cartosphere::Triangle *
  * *************************** */
@@ -235,54 +388,24 @@ Cartosphere::Triangle::circumcircle() const
 	return Cap(centroid(), diameter() / 2);
 }
 
-Cartosphere::Function
-Cartosphere::Triangle::element(size_t index) const
+Cartosphere::Element
+Cartosphere::Triangle::basis(size_t index) const
 {
-	Function f;
 	switch (index)
 	{
 	case 0:
-	{
 		// Construct f such that f(A)=1, f(B)=0, f(C)=0
-		Arc arc(B, C);
-		Point pole = arc.pole();
-		double height = M_PI_2 - distance(pole, A);
-		// The support of this function is supposed to be this triangle
-		f = [height, pole](const Cartosphere::Point& x) -> double {
-			return (M_PI_2 - distance(pole, x)) / height;
-		};
-	}
-	break;
+		return Element(Arc(B, C).pole(), A.image());
 	case 1:
-	{
 		// Construct f such that f(A)=0, f(B)=1, f(C)=0
-		Arc arc(C, A);
-		Point pole = arc.pole();
-		double height = M_PI_2 - distance(pole, B);
-		// The support of this function is supposed to be this triangle
-		f = [height, pole](const Cartosphere::Point& x) -> double {
-			return (M_PI_2 - distance(pole, x)) / height;
-		};
-	}
-	break;
+		return Element(Arc(C, A).pole(), B.image());
 	case 2:
-	{
 		// Construct f such that f(A)=0, f(B)=0, f(C)=1
-		Arc arc(A, B);
-		Point pole = arc.pole();
-		double height = M_PI_2 - distance(pole, C);
-		// The support of this function is supposed to be this triangle
-		f = [height, pole](const Cartosphere::Point& x) -> double {
-			return (M_PI_2 - distance(pole, x)) / height;
-		};
-	}
-	break;
+		return Element(Arc(A, B).pole(), C.image());
 	default:
-		f = [](const Cartosphere::Point& x) -> double {
-			return 0;
-		};
+		// The zero function
+		return Element();
 	}
-	return f;
 }
 
 FL3
@@ -367,82 +490,309 @@ Cartosphere::Triangle::gradient(size_t index, const Point &p) const
 	return gradient;
 }
 
-double
-Cartosphere::Triangle::integrate(const Function& f, Integrator intr) const
+// Orbits of the symmetric rules: the centroid (size 1), the points (a,a,1-2a)
+// (size 3), and the permutations of (a,b,1-a-b) (size 6), with the weight of
+// each point. Weights sum to one
+// Computed by Gauss-Newton on the moment equations of the Dubiner basis, with
+// the orbit structures of Dunavant (1985) and Xiao-Gimbutas (2010)
+// Refer to: https://doi.org/10.1002/nme.1620210612
+struct TriangleOrbit
 {
-	double integral = 0;
-	switch (intr)
+	int size;
+	double a, b, w;
+};
+static const vector<vector<TriangleOrbit>> TriangleGaussOrbits = {
+	// Degree 2, 3 nodes
 	{
-	case Integrator::Centroid:
+		{ 3, 0.16666666666666666, 0.16666666666666666, 0.33333333333333331 }
+	},
+	// Degree 3, 6 nodes
 	{
-		// Taking the function value at the centroid
-		integral = f(centroid()) * area();
-	} break;
-	case Integrator::ThreeVertices:
+		{ 3, 0.45723343604971062, 0.45723343604971062, 0.093731823996341723 },
+		{ 3, 0.15267059152254597, 0.15267059152254597, 0.23960150933699159 }
+	},
+	// Degree 4, 6 nodes
 	{
-		// Taking the averages of the three vertices
-		integral = (f(A) + f(B) + f(C)) / 3 * area();
-	} break;
-	case Integrator::Simpsons:
+		{ 3, 0.091576213509770771, 0.091576213509770771, 0.10995174365532188 },
+		{ 3, 0.44594849091596489, 0.44594849091596489, 0.22338158967801147 }
+	},
+	// Degree 5, 7 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.22500000000000003 },
+		{ 3, 0.47014206410511511, 0.47014206410511511, 0.13239415278850616 },
+		{ 3, 0.10128650732345636, 0.10128650732345636, 0.12593918054482714 }
+	},
+	// Degree 6, 12 nodes
+	{
+		{ 3, 0.24928674517091007, 0.24928674517091007, 0.11678627572637988 },
+		{ 3, 0.06308901449150231, 0.06308901449150231, 0.050844906370206944 },
+		{ 6, 0.053145049844816765, 0.63650249912139856, 0.082851075618373252 }
+	},
+	// Degree 7, 15 nodes
+	{
+		{ 3, 0.47430854963147878, 0.47430854963147878, 0.076047945137648051 },
+		{ 3, 0.036230761755379551, 0.036230761755379551, 0.018157617607382444 },
+		{ 3, 0.2417536940868634, 0.2417536940868634, 0.12767513464537841 },
+		{ 6, 0.04735701689772448, 0.75063877297813575, 0.055726317971462207 }
+	},
+	// Degree 8, 16 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.14431560767778706 },
+		{ 3, 0.050547228317031005, 0.050547228317031005, 0.032458497623198065 },
+		{ 3, 0.17056930775176019, 0.17056930775176019, 0.10321737053471822 },
+		{ 3, 0.45929258829272318, 0.45929258829272318, 0.095091634267284592 },
+		{ 6, 0.0083947774099576156, 0.72849239295540424, 0.027230314174434986 }
+	},
+	// Degree 9, 19 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.0971357962828025 },
+		{ 3, 0.48968251919873884, 0.48968251919873884, 0.031334700227136594 },
+		{ 3, 0.43708959149293913, 0.43708959149293913, 0.077827541004774917 },
+		{ 3, 0.044729513394452705, 0.044729513394452705, 0.025577675658697958 },
+		{ 3, 0.1882035356190335, 0.1882035356190335, 0.079647738927210679 },
+		{ 6, 0.22196298916076526, 0.036838412054736362, 0.043283539377289501 }
+	},
+	// Degree 10, 25 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.081743329146285959 },
+		{ 3, 0.032055373216943558, 0.032055373216943558, 0.013352968813149575 },
+		{ 3, 0.14216110105656435, 0.14216110105656435, 0.04595796360474471 },
+		{ 6, 0.32181299528883539, 0.14813288578382056, 0.063904906396424044 },
+		{ 6, 0.60123332868345924, 0.36914678182781097, 0.034184648162959415 },
+		{ 6, 0.028367665339938453, 0.16370173373718255, 0.025297757707288374 }
+	},
+	// Degree 11, 28 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.08689356709696569 },
+		{ 3, 0.43873085140679108, 0.43873085140679108, 0.068359639369311151 },
+		{ 3, 0.098691944606764156, 0.098691944606764156, 0.038311096317129215 },
+		{ 3, 0.49523776019336929, 0.49523776019336929, 0.017741778024567837 },
+		{ 3, 0.20881044604916033, 0.20881044604916033, 0.071331766664099905 },
+		{ 3, 0.027394976934199736, 0.027394976934199736, 0.0096653236283790744 },
+		{ 6, 0.67117120662025997, 0.045444962981750069, 0.040626829530495394 },
+		{ 6, 0.0040986411938972022, 0.85041681442226502, 0.0088527739515999997 }
+	},
+	// Degree 12, 33 nodes
+	{
+		{ 3, 0.48821738977380486, 0.48821738977380486, 0.025731066440455336 },
+		{ 3, 0.43972439229446031, 0.43972439229446031, 0.043692544538038385 },
+		{ 3, 0.27121038501211592, 0.27121038501211592, 0.062858224217885103 },
+		{ 3, 0.02131735045321035, 0.02131735045321035, 0.0061662610515590167 },
+		{ 3, 0.12757614554158592, 0.12757614554158592, 0.034796112930708917 },
+		{ 6, 0.27571326968551413, 0.60894323577978782, 0.040371557766380919 },
+		{ 6, 0.85801403354407257, 0.025734050548330219, 0.017316231108658896 },
+		{ 6, 0.6958360867878034, 0.022838332222257032, 0.022356773202303438 }
+	},
+	// Degree 13, 37 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.052363540179282637 },
+		{ 3, 0.49507335176593142, 0.49507335176593142, 0.011258697124331491 },
+		{ 3, 0.22951535832744624, 0.22951535832744624, 0.04724792968220503 },
+		{ 3, 0.024819137217796959, 0.024819137217796959, 0.0079806266231811241 },
+		{ 3, 0.41442285466007511, 0.41442285466007511, 0.047018331877499174 },
+		{ 3, 0.468671359022098, 0.468671359022098, 0.031533614267651264 },
+		{ 3, 0.11434982590780922, 0.11434982590780922, 0.03114581852670445 },
+		{ 6, 0.85139422787681118, 0.12639605280431035, 0.015510418291018929 },
+		{ 6, 0.69006071305419225, 0.018177869470626298, 0.017463517076928222 },
+		{ 6, 0.6362802476707623, 0.2686268523851198, 0.036872965551386118 }
+	},
+	// Degree 14, 42 nodes
+	{
+		{ 3, 0.06179988309087258, 0.06179988309087258, 0.014433699669776671 },
+		{ 3, 0.41764471934045394, 0.41764471934045394, 0.032788353544125362 },
+		{ 3, 0.17720553241254347, 0.17720553241254347, 0.042162588736993016 },
+		{ 3, 0.019390961248701055, 0.019390961248701055, 0.0049234036024000819 },
+		{ 3, 0.48896391036217862, 0.48896391036217862, 0.021883581369428893 },
+		{ 3, 0.27347752830883865, 0.27347752830883865, 0.051774104507291599 },
+		{ 6, 0.33686145979634502, 0.092916249356971792, 0.038571510787060677 },
+		{ 6, 0.87975717137017118, 0.0012683309328720448, 0.0050102288385006711 },
+		{ 6, 0.1722666878213556, 0.057124757403647898, 0.024665753212563677 },
+		{ 6, 0.29837288213625779, 0.68698016780808779, 0.014436308113533837 }
+	},
+	// Degree 15, 49 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.033281189260943728 },
+		{ 3, 0.22224152506223593, 0.22224152506223593, 0.046595004732121234 },
+		{ 3, 0.46202517282379607, 0.46202517282379607, 0.019138954734444883 },
+		{ 3, 0.061178825640249825, 0.061178825640249825, 0.014794169383088127 },
+		{ 3, 0.39867181441299437, 0.39867181441299437, 0.045557411872264433 },
+		{ 6, 0.037266765909107338, 0.0045919144120448235, 0.0028659716404286703 },
+		{ 6, 0.089909485084042312, 0.18014785050088761, 0.027755987885840366 },
+		{ 6, 0.14091833496887343, 0.84322597666444532, 0.010255719183792686 },
+		{ 6, 0.096688248521796416, 0.57509743413667458, 0.031435476453557203 },
+		{ 6, 0.019029833402814725, 0.28143694473510872, 0.01452056320029485 },
+		{ 6, 0.016435264319688937, 0.42634500609774018, 0.011243313064969595 }
+	},
+	// Degree 16, 55 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.040609463776437059 },
+		{ 3, 0.18329287112750522, 0.18329287112750522, 0.032917828642067444 },
+		{ 3, 0.015638872042112645, 0.015638872042112645, 0.0032227407893353072 },
+		{ 3, 0.26558401649013968, 0.26558401649013968, 0.018062138751553315 },
+		{ 3, 0.46395940533139662, 0.46395940533139662, 0.027208489873779901 },
+		{ 3, 0.49336599712438439, 0.49336599712438439, 0.010834686084738516 },
+		{ 3, 0.06949859681446445, 0.06949859681446445, 0.011724970421307388 },
+		{ 6, 0.16641861231274463, 0.75852549153993887, 0.01974192486398189 },
+		{ 6, 0.17586869996372323, 0.33930821279598034, 0.033823777589532526 },
+		{ 6, 0.64762278057138722, 0.3363250745629715, 0.012368554304275657 },
+		{ 6, 0.79105007016917939, 0.014543377069478541, 0.0096937320936978117 },
+		{ 6, 0.9040234710978724, 0.082396383532039763, 0.0063474887480124038 },
+		{ 6, 0.61996969338669905, 0.080548570544599005, 0.025937517823035952 }
+	},
+	// Degree 17, 60 nodes
+	{
+		{ 3, 0.28570650243658663, 0.28570650243658663, 0.037716237152795276 },
+		{ 3, 0.066654063479596959, 0.066654063479596959, 0.01245900080230544 },
+		{ 3, 0.46559787161889032, 0.46559787161889032, 0.025019450950497367 },
+		{ 3, 0.18035811626637063, 0.18035811626637063, 0.026312630588017989 },
+		{ 3, 0.41710344436159918, 0.41710344436159918, 0.027310926528102096 },
+		{ 3, 0.014755491660753926, 0.014755491660753926, 0.0027738875776376383 },
+		{ 6, 0.16872251349525949, 0.75323514593645813, 0.020557898320454515 },
+		{ 6, 0.067349377867361199, 0.62636903038645231, 0.022487772546691067 },
+		{ 6, 0.011575175903180596, 0.072505470799002353, 0.0045843484017358627 },
+		{ 6, 0.57129486794468409, 0.415475459295229, 0.010398439955839537 },
+		{ 6, 0.71507225911064254, 0.27179187005535477, 0.0086922145010011956 },
+		{ 6, 0.8247900701650881, 0.016017642362119288, 0.00797830020592959 },
+		{ 6, 0.15750547792686989, 0.5432755795961598, 0.026171625935336982 }
+	},
+	// Degree 18, 67 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.030748521239115825 },
+		{ 3, 0.41106710187591949, 0.41106710187591949, 0.033471994059847902 },
+		{ 3, 0.072438705567332867, 0.072438705567332867, 0.013790286604766935 },
+		{ 3, 0.15163850697260484, 0.15163850697260484, 0.020318338845458406 },
+		{ 3, 0.0037589443410683413, 0.0037589443410683413, 0.00053200561694777802 },
+		{ 3, 0.26561460990537422, 0.26561460990537422, 0.031116396602006144 },
+		{ 3, 0.47491821132404577, 0.47491821132404577, 0.013107027491738747 },
+		{ 6, 0.3850440344131637, 0.52452892523249572, 0.015328258194553142 },
+		{ 6, 0.26857330639601379, 0.14906691012577386, 0.027592886488579493 },
+		{ 6, 0.64392630694810493, 0.30206195771287081, 0.016365908413986566 },
+		{ 6, 0.047276141832651754, 0.012498932483495449, 0.0042175167747444424 },
+		{ 6, 0.75539841640570893, 0.066122458028403358, 0.016911653917480073 },
+		{ 6, 0.73298882140651656, 0.25650615977424152, 0.0077298352800062274 },
+		{ 6, 0.57724250665071453, 0.41106566867461836, 0.0095861244743615012 },
+		{ 6, 0.014331524778941987, 0.13277883027138929, 0.0076417049727196358 }
+	},
+	// Degree 19, 73 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.032702442975504224 },
+		{ 3, 0.25585897969795734, 0.25585897969795734, 0.030338728286983859 },
+		{ 3, 0.4543986318844751, 0.4543986318844751, 0.022386969603892911 },
+		{ 3, 0.48911148727978554, 0.48911148727978554, 0.010442636165901161 },
+		{ 3, 0.17752598888605678, 0.17752598888605678, 0.024130656978952347 },
+		{ 3, 0.40129540483922749, 0.40129540483922749, 0.030118733991528184 },
+		{ 3, 0.056067853185146267, 0.056067853185146267, 0.0081080292402726448 },
+		{ 3, 0.10979754178887699, 0.10979754178887699, 0.016183669057477781 },
+		{ 3, 0.01253751604230314, 0.01253751604230314, 0.0020516568558543906 },
+		{ 6, 0.0014811816665387632, 0.1571110383800845, 0.0021505255385552615 },
+		{ 6, 0.30804538127557324, 0.13487001845237503, 0.025518348193464841 },
+		{ 6, 0.26452403357480092, 0.72115876662705924, 0.0089108238078818916 },
+		{ 6, 0.59823345982486331, 0.39783143412872446, 0.0040665986367183198 },
+		{ 6, 0.92459935766353929, 0.010409778172896978, 0.0038504300276767881 },
+		{ 6, 0.033260504716964248, 0.14343669261877048, 0.010405545108312464 },
+		{ 6, 0.70153595078558406, 0.22290066955363341, 0.018279752267887514 },
+		{ 6, 0.35677074676499299, 0.047473390810132757, 0.01615369583315391 }
+	},
+	// Degree 20, 79 nodes
+	{
+		{ 1, 1.0 / 3, 1.0 / 3, 0.0039993788997575155 },
+		{ 3, 0.17107305294503111, 0.17107305294503111, 0.015494646021846864 },
+		{ 3, 0.0098828346121804956, 0.0098828346121804956, 0.0013286347276867672 },
+		{ 3, 0.033214661470459338, 0.033214661470459338, 0.0038049196326368933 },
+		{ 3, 0.46651186450882759, 0.46651186450882759, 0.018327756024287451 },
+		{ 3, 0.11281929816630963, 0.11281929816630963, 0.015501463166082724 },
+		{ 3, 0.24394447497064983, 0.24394447497064983, 0.030244990858376931 },
+		{ 3, 0.37588647216014287, 0.37588647216014287, 0.030968127829858742 },
+		{ 3, 0.49102873288315235, 0.49102873288315235, 0.0070342069381512549 },
+		{ 6, 0.35739825433495243, 0.14296506031885725, 0.025827266552948185 },
+		{ 6, 0.3377643630552567, 0.052393822824160483, 0.016941597931421772 },
+		{ 6, 0.63163592607508601, 0.11948004857288042, 0.018579346881071931 },
+		{ 6, 0.59076292557410914, 0.40100320928594935, 0.005612432903237187 },
+		{ 6, 0.040294623544508218, 0.095798890536091058, 0.0085430097944927327 },
+		{ 6, 0.19779182018921657, 0.055113038273260966, 0.014660964863620172 },
+		{ 6, 0.71793410438754879, 0.27060538308713922, 0.0072402681593866135 },
+		{ 6, 0.0092819436195844957, 0.15564108377649633, 0.0050342527465695244 },
+		{ 6, 0.0047458687513118221, 0.063361304259387644, 0.0022085910844951489 }
+	}
+};
+
+const Cartosphere::Triangle::Rule&
+Cartosphere::Triangle::rule(Integrator intr)
+{
+	static const size_t Count = (size_t)Integrator::Gauss20 + 1;
+	static Rule rules[Count];
+	static std::once_flag flags[Count];
+
+	size_t index = (size_t)intr;
+	std::call_once(flags[index], [intr, index]() {
+		Rule& rule = rules[index];
+		if (intr >= Integrator::Gauss2)
+		{
+			size_t degree = 2 + index - (size_t)Integrator::Gauss2;
+			for (const auto& orbit : TriangleGaussOrbits[degree - 2])
+			{
+				double a = orbit.a, b = orbit.b, c = 1 - a - b;
+				vector<FL3> points;
+				if (orbit.size == 1)
+				{
+					points = { FL3(a, a, a) };
+				}
+				else if (orbit.size == 3)
+				{
+					points = { FL3(a, a, c), FL3(a, c, a), FL3(c, a, a) };
+				}
+				else
+				{
+					points = { FL3(a, b, c), FL3(a, c, b), FL3(b, a, c),
+						FL3(b, c, a), FL3(c, a, b), FL3(c, b, a) };
+				}
+				rule.nodes.insert(rule.nodes.end(), points.begin(), points.end());
+				rule.weights.insert(rule.weights.end(), points.size(), orbit.w);
+			}
+		}
+		else if (intr >= Integrator::Refinement1)
+		{
+			// Subdivide each side into n segments: there are n(n+1)/2 upright
+			// and n(n-1)/2 inverted triangles of the same area
+			size_t levels = 1 + index - (size_t)Integrator::Refinement1;
+			size_t n = (size_t)1 << levels;
+			double h = 1.0 / (3 * n);
+			rule.nodes.reserve(n * n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				for (size_t j = 0; i + j < n; ++j)
+				{
+					double u = (3 * i + 1) * h;
+					double v = (3 * j + 1) * h;
+					rule.nodes.emplace_back(u, v, 1 - u - v);
+					if (i + j + 1 < n)
+					{
+						u = (3 * i + 2) * h;
+						v = (3 * j + 2) * h;
+						rule.nodes.emplace_back(u, v, 1 - u - v);
+					}
+				}
+			}
+			rule.weights.assign(n * n, 1.0 / (n * n));
+		}
+	});
+	return rules[index];
+}
+
+size_t
+Cartosphere::Triangle::evaluations(Integrator intr)
+{
+	switch (intr)
 	{
-		// Analogy to Simpson's rule
-		integral = (f(A) + f(B) + f(C) + 3 * f(centroid())) / 6 * area();
-	} break;
-	case Integrator::Refinement1:
-	case Integrator::Refinement2:
-	case Integrator::Refinement3:
-	case Integrator::Refinement4:
-	case Integrator::Refinement5:
-	case Integrator::Refinement6:
-	case Integrator::Refinement7:
-	case Integrator::Refinement8:
-	case Integrator::Refinement9:
-	case Integrator::Refinement10:
-	{
-		// Create a mesh
-		TriangularMesh m;
-		m.load(*this);
-		// Refine five levels
-		unsigned levels = 0;
-		switch (intr)
-		{
-		case Integrator::Refinement1:
-			levels = 1; break;
-		case Integrator::Refinement2:
-			levels = 2; break;
-		case Integrator::Refinement3:
-			levels = 3; break;
-		case Integrator::Refinement4:
-			levels = 4; break;
-		case Integrator::Refinement5:
-			levels = 5; break;
-		case Integrator::Refinement6:
-			levels = 6; break;
-		case Integrator::Refinement7:
-			levels = 7; break;
-		case Integrator::Refinement8:
-			levels = 8; break;
-		case Integrator::Refinement9:
-			levels = 9; break;
-		case Integrator::Refinement10:
-			levels = 10; break;
 	case Integrator::Centroid:
+		return 1;
 	case Integrator::ThreeVertices:
+		return 3;
 	case Integrator::Simpsons:
+		return 4;
 	default:
-		break;
-		}
-		for (unsigned k = 0; k < levels; ++k)
-		{
-			m.refine();
-		}
-		// Integrate through each refined simplex
-		integral = m.integrate(f,
-			TriangularMesh::Quadrature::AreaWeighted,
-			Integrator::Centroid);
-	} break;
+		return rule(intr).nodes.size();
 	}
-	return integral;
 }
 
 double
@@ -461,132 +811,270 @@ Cartosphere::Polygon::area() const
 	return sum - (n - 2) * M_PI;
 }
 
+FL3
+Cartosphere::TriangularMesh::Face::barycentric(const Point& p) const
+{
+	// The elements are the distances to the opposite edges over the heights
+	FL3 t(basis(0)(p), basis(1)(p), basis(2)(p));
+	double sum = t.x + t.y + t.z;
+	return t / sum;
+}
+
+Cartosphere::Point
+Cartosphere::TriangularMesh::Face::centroid() const
+{
+	FL3 c = vertex(0).image() + vertex(1).image() + vertex(2).image();
+	return Cartosphere::Point(Cartosphere::Image(c.normalize()));
+}
+
 void
-Cartosphere::TriangularMesh::Tree::_insert(Node::Pointer n, size_t level)
+Cartosphere::TriangularMesh::Tree::clear()
 {
-	Node::Pointer subtree = _choose(n, level);
+	_nodes.clear();
+	_entries.clear();
+	_height = 0;
+}
 
-	if (subtree->degree() <= M)
+void
+Cartosphere::TriangularMesh::Tree::build(const TriangularMesh& mesh)
+{
+	// Clear the tree
+	clear();
+	size_t F = mesh._FV.size();
+	if (F == 0)
 	{
-		subtree->store(subtree);
+		return;
 	}
 
-	Node::Pointer iter = subtree;
-	while (iter->degree() > M)
+	// Entries are partitioned by the (unnormalized) centroids of triangles
+	vector<FL3> centroids(F);
+	_entries.resize(F);
+	for (size_t i = 0; i < F; ++i)
 	{
-		bool split = _overflow(iter, iter->height());
+		Face t = mesh.face(i);
+		centroids[i] = t.vertex(0).image() + t.vertex(1).image() + t.vertex(2).image();
+		_entries[i] = i;
+	}
 
-		if (!split) break;
+	// Split recursively from the root
+	_nodes.emplace_back();
+	_split(0, 0, F, centroids, mesh, 1);
+}
 
-		if (iter->isRoot())
-		{
-			// TODO
-		}
+void
+Cartosphere::TriangularMesh::Tree::refine(const TriangularMesh& mesh,
+	size_t children)
+{
+	size_t F = mesh._FV.size();
+	if (_nodes.empty() || children * _entries.size() != F)
+	{
+		build(mesh);
+		return;
 	}
 
-	// Adjust all circumcircles in the insertion path
-	for (iter = subtree; !iter->isRoot(); iter = iter->parent())
+	// The children of a face lie within the face, so every cap still bounds
+	// its subtree once the entries are replaced by the children, and the
+	// leaves keep their caps when split
+	vector<size_t> entries(F);
+	for (size_t e = 0; e < _entries.size(); ++e)
 	{
-		// TODO
+		for (size_t k = 0; k < children; ++k)
+		{
+			entries[children * e + k] = children * _entries[e] + k;
+		}
 	}
-}
-
-Cartosphere::TriangularMesh::Tree::Node::Pointer
-Cartosphere::TriangularMesh::Tree::_choose(Node::Pointer n, size_t level)
-{
-	// Based on the R-tree, not the R*-tree
-	// This is because the overlap enlargement might be difficult to compute
-	Node::Pointer iter = make_shared<Node>(_root);
+	_entries.swap(entries);
+	vector<size_t>().swap(entries);
 
-	while (!iter->isLeaf())
+	// Depth of each node, children being allocated after their parents
+	size_t count = _nodes.size();
+	vector<size_t> depth(count, 1);
+	for (size_t n = 0; n < count; ++n)
 	{
-		typedef std::tuple<Node::Pointer, double, double> PointerWithAreas;
-		
-		vector<PointerWithAreas> areas;
-		std::transform(iter->begin(), iter->end(), std::back_inserter(areas),
-			[n](const Node::Pointer& a) {
-				double before = a->cap().radius();
-				//double after = a->cap().combine(n->cap()).radius();
-				double after = 0;
-				return std::make_tuple(a, after - before, before);
+		if (!_nodes[n].leaf)
+		{
+			for (size_t c = _nodes[n].first; c < _nodes[n].first + _nodes[n].count; ++c)
+			{
+				depth[c] = depth[n] + 1;
 			}
-		);
+		}
+	}
 
-		std::sort(areas.begin(), areas.end(),
-			[](const PointerWithAreas& a, const PointerWithAreas& b) {
-				return std::get<1>(a) < std::get<1>(b)
-					|| std::get<2>(a) < std::get<2>(b);
+	// Split the leaves that overflow
+	vector<FL3> centroids(F);
+#pragma omp parallel for if (F >= 1024) num_threads(ThreadsMaximum)
+	for (int i = 0; i < (int)F; ++i)
+	{
+		Face t = mesh.face(i);
+		centroids[i] = t.vertex(0).image() + t.vertex(1).image() + t.vertex(2).image();
+	}
+	for (size_t n = 0; n < count; ++n)
+	{
+		if (_nodes[n].leaf)
+		{
+			size_t first = children * _nodes[n].first;
+			size_t last = first + children * _nodes[n].count;
+			_nodes[n].first = first;
+			_nodes[n].count = last - first;
+			if (last - first > M)
+			{
+				_split(n, first, last, centroids, mesh, depth[n], false);
 			}
-		);
-
-		iter = std::get<0>(areas.front());
+		}
 	}
-
-	return iter;
 }
 
-bool
-Cartosphere::TriangularMesh::Tree::_overflow(Node::Pointer n, size_t level)
+size_t
+Cartosphere::TriangularMesh::Tree::find(const Point& p, const TriangularMesh& mesh) const
 {
-	if (level != height() && !_overflown[level])
+	if (_nodes.empty())
 	{
-		_reinsert(n);
-		return false;
+		return npos;
 	}
-	else
+
+	// Depth-first search through every cap containing the point
+	const FL3 x = p.image();
+	size_t stack[M * 64];
+	size_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
 	{
-		_split(n);
-		return true;
+		const Node& node = _nodes[stack[--top]];
+		if (dot(node.apex, x) < node.cos_radius - 1e-9)
+		{
+			continue;
+		}
+		if (node.leaf)
+		{
+			for (size_t e = node.first; e < node.first + node.count; ++e)
+			{
+				if (mesh.face(_entries[e]).contains(p))
+				{
+					return _entries[e];
+				}
+			}
+		}
+		else
+		{
+			for (size_t c = node.first; c < node.first + node.count; ++c)
+			{
+				stack[top++] = c;
+			}
+		}
 	}
+	return npos;
 }
 
 void
-Cartosphere::TriangularMesh::Tree::_reinsert(Node::Pointer n)
+Cartosphere::TriangularMesh::Tree::_split(size_t node, size_t first, size_t last,
+	const vector<FL3>& centroids, const TriangularMesh& mesh, size_t depth,
+	bool bound)
 {
-	auto& cap = n->cap();
-
-	typedef std::pair<Node::Pointer, double> PointerWithDistance;
-	vector<PointerWithDistance> dist;
+	_height = std::max(_height, depth);
 
-	std::transform(n->begin(), n->end(), std::back_inserter(dist),
-		[&cap](Node::Pointer n) {
-			double d = distance(cap.apex(), n->cap().apex());
-			return std::make_pair(n, d);
+	// Small ranges become leaves, bounded by the cap around the mean
+	// direction through the farthest vertex, which is close to the minimum
+	// for so few triangles and much cheaper
+	if (last - first <= M)
+	{
+		_nodes[node].leaf = true;
+		_nodes[node].first = first;
+		_nodes[node].count = last - first;
+		if (!bound)
+		{
+			return;
 		}
-	);
-
-	std::sort(dist.begin(), dist.end(),
-		[](const PointerWithDistance& a, const PointerWithDistance& b) {
-			return a.second > b.second;
+		FL3 mean(0, 0, 0);
+		for (size_t e = first; e < last; ++e)
+		{
+			Face t = mesh.face(_entries[e]);
+			mean += t.vertex(0).image() + t.vertex(1).image() + t.vertex(2).image();
 		}
-	);
-
-	Node::Pointers toRemove;
-	std::transform(dist.begin(), dist.begin() + p, std::back_inserter(toRemove),
-		[](const PointerWithDistance& a) {
-			return a.first;
+		double cos_radius = -1;
+		if (mean.norm2sq() > 0)
+		{
+			mean /= std::sqrt(mean.norm2sq());
+			cos_radius = 1;
+			for (size_t e = first; e < last; ++e)
+			{
+				Face t = mesh.face(_entries[e]);
+				for (size_t j = 0; j < 3; ++j)
+				{
+					cos_radius = std::min(cos_radius, dot(mean, t.vertex(j).image()));
+				}
+			}
 		}
-	);
+		_nodes[node].apex = mean;
+		_nodes[node].cos_radius = cos_radius > 0 ? cos_radius : -1;
+		return;
+	}
 
-	Node::Pointers toRemain;
-	std::transform(dist.begin() + p, dist.end(), std::back_inserter(toRemain),
-		[](const PointerWithDistance& a) {
-			return a.first;
+	// Bound all vertices in the subtree by their minimum enclosing cap
+	// A cap no larger than a hemisphere is convex, hence bounds the triangles
+	if (bound)
+	{
+		vector<Point> vertices;
+		vertices.reserve(3 * (last - first));
+		for (size_t e = first; e < last; ++e)
+		{
+			Face t = mesh.face(_entries[e]);
+			vertices.push_back(t.vertex(0));
+			vertices.push_back(t.vertex(1));
+			vertices.push_back(t.vertex(2));
 		}
-	);
-
-	n->update(toRemain);
+		Cap cap = Cap::circumscribe(vertices.begin(), vertices.end());
+		_nodes[node].apex = cap.apex().image();
+		_nodes[node].cos_radius = (cap.radius() < M_PI_2) ? cos(cap.radius()) : -1;
+	}
 
-	for (int i = 0; i < toRemain.size(); ++i)
+	// Halve every group along its axis of greatest variance until there are
+	// M groups
+	vector<size_t> bounds = { first, last };
+	while (bounds.size() <= M)
 	{
-		_insert(toRemain[i]);
+		vector<size_t> halves = { first };
+		for (size_t g = 0; g + 1 < bounds.size(); ++g)
+		{
+			size_t lo = bounds[g], hi = bounds[g + 1];
+			FL3 mean(0, 0, 0), var(0, 0, 0);
+			for (size_t e = lo; e < hi; ++e)
+			{
+				mean += centroids[_entries[e]];
+			}
+			mean /= (double)(hi - lo);
+			for (size_t e = lo; e < hi; ++e)
+			{
+				FL3 d = centroids[_entries[e]] - mean;
+				var += FL3(d.x * d.x, d.y * d.y, d.z * d.z);
+			}
+			int axis = (var.x >= var.y && var.x >= var.z) ? 0 : (var.y >= var.z ? 1 : 2);
+			auto coordinate = [&centroids, axis](size_t i) {
+				const FL3& c = centroids[i];
+				return axis == 0 ? c.x : (axis == 1 ? c.y : c.z);
+			};
+			size_t mid = lo + (hi - lo) / 2;
+			std::nth_element(_entries.begin() + lo, _entries.begin() + mid,
+				_entries.begin() + hi,
+				[&coordinate](size_t a, size_t b) {
+					return coordinate(a) < coordinate(b);
+				});
+			halves.push_back(mid);
+			halves.push_back(hi);
+		}
+		bounds = halves;
 	}
-}
-
-void
-Cartosphere::TriangularMesh::Tree::_split(Node::Pointer n)
-{
 
+	// Allocate the children contiguously, then recurse
+	size_t child = _nodes.size();
+	size_t count = bounds.size() - 1;
+	_nodes.resize(child + count);
+	_nodes[node].leaf = false;
+	_nodes[node].first = child;
+	_nodes[node].count = count;
+	for (size_t g = 0; g < count; ++g)
+	{
+		_split(child + g, bounds[g], bounds[g + 1], centroids, mesh, depth + 1);
+	}
 }
 
 double
@@ -616,7 +1104,7 @@ Cartosphere::TriangularMesh::integrate(
 				const auto& fs = _VF[i];
 				std::transform(fs.begin(), fs.end(), std::back_inserter(dual),
 					[this, v](size_t k) {
-						Point centroid = _vt[k].centroid();
+						Point centroid = face(k).centroid();
 						double azimuth = v.azimuth(centroid);
 						return std::make_pair(centroid, azimuth);
 					}
@@ -656,14 +1144,14 @@ Cartosphere::TriangularMesh::integrate(
 		}
 		else
 		{
-			for (size_t i = 0; i < _vt.size(); ++i)
+			for (size_t i = 0; i < _FV.size(); ++i)
 			{
-				const Triangle& t = _vt[i];
+				Face t = face(i);
 
 				// Obtain the restriction of basis functions
-				auto e_a = t.element(0);
-				auto e_b = t.element(1);
-				auto e_c = t.element(2);
+				auto e_a = t.basis(0);
+				auto e_b = t.basis(1);
+				auto e_c = t.basis(2);
 
 				// Obtain the values
 				size_t index_a;
@@ -704,14 +1192,14 @@ Cartosphere::TriangularMesh::lebesgue(
 	double integral = 0;
 
 	// Integrate error in each triangle
-	for (size_t i = 0; i < _vt.size(); ++i)
+	for (size_t i = 0; i < _FV.size(); ++i)
 	{
-		const Triangle& t = _vt[i];
+		Face t = face(i);
 
 		// Obtain the restriction of basis functions
-		auto e_a = t.element(0);
-		auto e_b = t.element(1);
-		auto e_c = t.element(2);
+		auto e_a = t.basis(0);
+		auto e_b = t.basis(1);
+		auto e_c = t.basis(2);
 
 		// Obtain the values
 		size_t index_a;
@@ -749,21 +1237,26 @@ Cartosphere::TriangularMesh::clear()
 	_V.clear();
 	_E.clear();
 	_F.clear();
-	_vt.clear();
+	_FA.clear();
+	_FP.clear();
+	_tree.clear();
+	_HV.clear();
+	_VB.clear();
 	_vInfo.clear();
 
 	// Reset state flags
 	_bLoadSuccess = false;
 	_bParseSuccess = false;
+	_bHierarchy = false;
 }
 
 double
 Cartosphere::TriangularMesh::area() const
 {
 	double area = 0;
-	for (auto& simplex : _vt)
+	for (double a : _FA)
 	{
-		area += simplex.area();
+		area += a;
 	}
 	return area;
 }
@@ -772,9 +1265,9 @@ double
 Cartosphere::TriangularMesh::areaEuclidean() const
 {
 	double area = 0;
-	for (auto& simplex : _vt)
+	for (size_t i = 0; i < _FV.size(); ++i)
 	{
-		area += simplex.areaEuclidean();
+		area += face(i).triangle().areaEuclidean();
 	}
 	return area;
 }
@@ -804,258 +1297,417 @@ Cartosphere::TriangularMesh::load(const Triangle& t)
 }
 
 bool
-Cartosphere::TriangularMesh::load(const string& path)
+Cartosphere::TriangularMesh::generate(Polyhedron base, size_t level)
 {
 	if (_bLoadSuccess || _bParseSuccess) clear();
 
-	// Opens given path
-	ifstream ifs(path);
-	if (!ifs.is_open())
+	// Edges and faces of the base polyhedra, as in data/icosahedron.csm and
+	// data/octahedron.csm, the faces counter-clockwise seen from outside
+	vector<IndexTriplet> faces;
+	if (base == Polyhedron::Icosahedron)
 	{
-		string message;
+		// Poles, and two rings of five at z = +-1/sqrt(5), the upper ring
+		// offset by half a step in azimuth
+		double z = 1 / sqrt(5.0), r = 2 * z;
+		_V.emplace_back(0, 0, 1);
+		for (int k = 0; k < 5; ++k)
 		{
-			stringstream sst;
-			sst << "Could not load path " << path;
-			message = sst.str();
+			double azimuth = cs_deg2rad(72 * k - 36);
+			_V.emplace_back(r * cos(azimuth), r * sin(azimuth), z);
 		}
-		_vInfo.push_back(message);
-		return isReady();
-	}
-
-	// Temporary state variables
-	size_t lineNumber = 0;
-	size_t lineParsed = 0;
-	vector<size_t> specs;
-	double coords[4];
-	// Temporary state flags
-	size_t format = 0;
-
-	// Start parsing file line by line
-	string line;
-	istringstream iss;
-	while (std::getline(ifs, line))
-	{
-		// Increment line number and skip empty lines
-		++lineNumber;
-		if (!line.empty() && line.back() == '\r') { line.pop_back(); }
-		if (!line.length()) continue;
-		iss.str(line);
-
-		// Skip comment lines and strip inline comments
-		if (line[0] == '#') continue;
-		auto indexofPound = line.find_first_of('#');
-		if (indexofPound != string::npos)
+		for (int k = 0; k < 5; ++k)
 		{
-			line.erase(indexofPound);
+			double azimuth = cs_deg2rad(72 * k);
+			_V.emplace_back(r * cos(azimuth), r * sin(azimuth), -z);
 		}
-
-		// Parse sanitized inputs
-		if (lineParsed == 0)
+		_V.emplace_back(0, 0, -1);
+		_E = {
+			{ 0, 1 }, { 0, 2 }, { 0, 3 }, { 0, 4 }, { 0, 5 },
+			{ 1, 2 }, { 2, 3 }, { 3, 4 }, { 4, 5 }, { 5, 1 },
+			{ 1, 6 }, { 6, 2 }, { 2, 7 }, { 7, 3 }, { 3, 8 },
+			{ 8, 4 }, { 4, 9 }, { 9, 5 }, { 5, 10 }, { 10, 1 },
+			{ 6, 7 }, { 7, 8 }, { 8, 9 }, { 9, 10 }, { 10, 6 },
+			{ 6, 11 }, { 7, 11 }, { 8, 11 }, { 9, 11 }, { 10, 11 },
+		};
+		faces = {
+			{ 0, 1, 2 }, { 0, 2, 3 }, { 0, 3, 4 }, { 0, 4, 5 }, { 0, 5, 1 },
+			{ 2, 1, 6 }, { 2, 6, 7 }, { 3, 2, 7 }, { 3, 7, 8 }, { 4, 3, 8 },
+			{ 4, 8, 9 }, { 5, 4, 9 }, { 5, 9, 10 }, { 1, 5, 10 }, { 1, 10, 6 },
+			{ 7, 6, 11 }, { 8, 7, 11 }, { 9, 8, 11 }, { 10, 9, 11 }, { 6, 10, 11 },
+		};
+	}
+	else
+	{
+		_V.emplace_back(0, 0, 1);
+		_V.emplace_back(1, 0, 0);
+		_V.emplace_back(0, 1, 0);
+		_V.emplace_back(-1, 0, 0);
+		_V.emplace_back(0, -1, 0);
+		_V.emplace_back(0, 0, -1);
+		_E = {
+			{ 0, 1 }, { 1, 2 }, { 2, 0 }, { 2, 3 }, { 3, 0 }, { 3, 4 },
+			{ 4, 0 }, { 4, 1 }, { 1, 5 }, { 5, 2 }, { 5, 3 }, { 5, 4 },
+		};
+		faces = {
+			{ 0, 1, 2 }, { 0, 2, 3 }, { 0, 3, 4 }, { 0, 4, 1 },
+			{ 2, 1, 5 }, { 3, 2, 5 }, { 4, 3, 5 }, { 1, 4, 5 },
+		};
+	}
+	for (const auto& v : faces)
+	{
+		DirectedEdge directed[3];
+		for (size_t j = 0; j < 3; ++j)
 		{
-			// Section 0: Size specifications
-			size_t size;
-
-			iss >> size;
-			if (iss.fail() || size == 0)
+			Index a = v[j], b = v[(j + 1) % 3];
+			for (size_t e = 0; e < _E.size(); ++e)
 			{
-				string message;
+				if (_E[e] == UndirectedEdge(a, b) || _E[e] == UndirectedEdge(b, a))
 				{
-					stringstream sst;
-					sst << "Error in Line " << lineNumber
-						<< ": Number of points is missing or zero";
-					message = sst.str();
+					directed[j] = DirectedEdge(e, _E[e].first == a);
 				}
-				_vInfo.push_back(message);
-				return isReady();
 			}
-			specs.push_back(size);
+		}
+		_F.emplace_back(directed[0], directed[1], directed[2]);
+	}
+	_bLoadSuccess = true;
+	_populate();
+	_bHierarchy = true;
+
+	// Each level quadruples the edges and faces, and adds a vertex per edge,
+	// so a base (V', E', F') ends at E = 4^L E', F = 4^L F', V = V' + (E - E')/3
+	// Only the connectivity and the tree follow each level; the rest is
+	// refreshed once at the end
+	size_t E = _E.size() << (2 * level);
+	_V.reserve(_V.size() + (E - _E.size()) / 3);
+	for (size_t l = 0; l < level && isReady(); ++l)
+	{
+		_retain_level();
+		_subdivide();
+		_tree.refine(*this);
+	}
+	if (level > 0 && isReady())
+	{
+		_populate_geometry();
+		_populate_incidence();
+	}
+	return isReady();
+}
 
-			iss >> size;
-			if (iss.fail() || size == 0)
-			{
-				string message;
-				{
-					stringstream sst;
-					sst << "Error in Line " << lineNumber
-						<< ": Number of edges is missing or zero";
-					message = sst.str();
-				}
-				_vInfo.push_back(message);
-				return isReady();
-			}
-			specs.push_back(size);
-
-			iss >> size;
-			if (iss.fail() || size == 0)
+// A read-only view of a whole file, mapped into memory where supported
+struct MappedFile
+{
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef APPLE_LIKE
+	MappedFile(const string& path)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return;
+		}
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void* map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map != MAP_FAILED)
 			{
-				string message;
-				{
-					stringstream sst;
-					sst << "Error in Line " << lineNumber
-						<< ": Number of triangles is missing or zero";
-					message = sst.str();
-				}
-				_vInfo.push_back(message);
-				return isReady();
+				data = (const char*)map;
+				size = (size_t)st.st_size;
 			}
-			specs.push_back(size);
+		}
+		close(fd);
+	}
+	~MappedFile() { if (data) munmap((void*)data, size); }
+#else
+	vector<char> buffer;
+	MappedFile(const string& path)
+	{
+		ifstream ifs(path, std::ios::binary | std::ios::ate);
+		if (ifs.is_open())
+		{
+			buffer.resize((size_t)ifs.tellg());
+			ifs.seekg(0);
+			ifs.read(buffer.data(), buffer.size());
+			data = buffer.data();
+			size = ifs.good() ? buffer.size() : 0;
+		}
+	}
+#endif
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+};
+
+// Skip spaces and tabs
+static const char*
+skipBlanks(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+	{
+		++p;
+	}
+	return p;
+}
+
+// Parse the next blank-separated number of a line
+// Fails if there is no token, or if the token is not entirely a number
+template<typename T>
+static bool
+scanNumber(const char*& p, const char* end, T& value)
+{
+	p = skipBlanks(p, end);
+	if (p < end && *p == '+')
+	{
+		++p;
+	}
+	auto result = std::from_chars(p, end, value);
+	if (result.ec != std::errc() ||
+		(result.ptr < end && *result.ptr != ' ' && *result.ptr != '\t'))
+	{
+		return false;
+	}
+	p = result.ptr;
+	return true;
+}
+
+bool
+Cartosphere::TriangularMesh::load(const string& path)
+{
+	if (_bLoadSuccess || _bParseSuccess) clear();
+
+	// Generated meshes are named by their base and level
+	size_t colon = path.find(':');
+	if (colon != string::npos && colon + 1 < path.size() &&
+		path.find_first_not_of("0123456789", colon + 1) == string::npos)
+	{
+		string name = path.substr(0, colon);
+		size_t level = std::stoul(path.substr(colon + 1));
+		if (name == "icosa")
+		{
+			return generate(Polyhedron::Icosahedron, level);
+		}
+		if (name == "octa")
+		{
+			return generate(Polyhedron::Octahedron, level);
+		}
+	}
+
+	// Binary meshes are mapped rather than parsed
+	if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".csmb") == 0)
+	{
+		return _load_binary(path);
+	}
+
+	// Opens given path
+	MappedFile file(path);
+	if (file.data == nullptr)
+	{
+		_vInfo.push_back("Could not load path " + path);
+		return isReady();
+	}
 
-			iss >> format;
-			if (iss.fail())
+	// 1. Index the lines with content, in chunks that start after a newline
+	// Empty lines and comment lines are skipped, and inline comments stripped
+	struct Line
+	{
+		const char* begin;
+		const char* end;
+		size_t number;
+	};
+	const char* text = file.data;
+	size_t chunks = std::min<size_t>(256, file.size / (1 << 20) + 1);
+	vector<vector<Line>> chunkLines(chunks);
+	vector<size_t> chunkBreaks(chunks, 0);
+	auto chunkBegin = [text, &file, chunks](size_t c) {
+		if (c == 0) return text;
+		if (c == chunks) return text + file.size;
+		const char* p = text + c * (file.size / chunks);
+		const char* newline = (const char*)std::memchr(p - 1, '\n', text + file.size - p + 1);
+		return newline ? newline + 1 : text + file.size;
+	};
+#pragma omp parallel for if (chunks > 1) num_threads(ThreadsMaximum)
+	for (int c = 0; c < (int)chunks; ++c)
+	{
+		const char* p = chunkBegin(c);
+		const char* last = chunkBegin(c + 1);
+		size_t number = 0;
+		while (p < last)
+		{
+			const char* newline = (const char*)std::memchr(p, '\n', last - p);
+			const char* end = newline ? newline : last;
+			++number;
+			const char* hash = (const char*)std::memchr(p, '#', end - p);
+			const char* stop = hash ? hash : end;
+			if (stop > p && stop[-1] == '\r') --stop;
+			if (end > p && *p != '#' && !(end - p == 1 && *p == '\r'))
 			{
-				format = 0;
+				chunkLines[c].push_back({ p, stop, number });
 			}
-			else if (format != 0)
+			p = end + 1;
+		}
+		chunkBreaks[c] = number;
+	}
+	vector<Line> lines;
+	size_t lineOffset = 0;
+	for (size_t c = 0; c < chunks; ++c)
+	{
+		for (Line& line : chunkLines[c])
+		{
+			line.number += lineOffset;
+			lines.push_back(line);
+		}
+		lineOffset += chunkBreaks[c];
+		vector<Line>().swap(chunkLines[c]);
+	}
+
+	// 2. Section 0: Size specifications
+	size_t specs[3] = { 0, 0, 0 };
+	{
+		static const char* names[3] = { "points", "edges", "triangles" };
+		const char* p = lines.empty() ? nullptr : lines[0].begin;
+		const char* end = lines.empty() ? nullptr : lines[0].end;
+		size_t number = lines.empty() ? 0 : lines[0].number;
+		for (size_t i = 0; i < 3; ++i)
+		{
+			if (lines.empty() || !scanNumber(p, end, specs[i]) || specs[i] == 0)
 			{
-				string message;
-				{
-					stringstream sst;
-					sst << "Error in Line " << lineNumber
-						<< ": File format ID " << format << " is unrecognized";
-					message = sst.str();
-				}
-				_vInfo.push_back(message);
+				_vInfo.push_back("Error in Line " + std::to_string(number)
+					+ ": Number of " + names[i] + " is missing or zero");
 				return isReady();
 			}
-			specs.push_back(format);
 		}
-		else if (lineParsed <= specs[0])
+		size_t format = 0;
+		if (scanNumber(p, end, format) && format != 0)
+		{
+			_vInfo.push_back("Error in Line " + std::to_string(number)
+				+ ": File format ID " + std::to_string(format) + " is unrecognized");
+			return isReady();
+		}
+	}
+
+	// Sections cut short by the end of file keep the lines present
+	size_t available = lines.size() - 1;
+	for (size_t i = 0; i < 3; ++i)
+	{
+		specs[i] = std::min(specs[i], available);
+		available -= specs[i];
+	}
+
+	// 3. Sections 1 to 3 in parallel, by blocks of lines
+	// Each block collects its own diagnostics, merged in line order next
+	struct Diagnostic
+	{
+		size_t line;
+		bool error;
+		string message;
+	};
+	const size_t BlockSize = 4096;
+	size_t total = specs[0] + specs[1] + specs[2];
+	size_t blocks = (total + BlockSize - 1) / BlockSize;
+	vector<vector<Diagnostic>> diagnostics(blocks);
+	_V.resize(specs[0]);
+	_E.resize(specs[1]);
+	_F.resize(specs[2]);
+#pragma omp parallel for if (blocks > 1) num_threads(ThreadsMaximum)
+	for (int b = 0; b < (int)blocks; ++b)
+	{
+		auto report = [&diagnostics, b](size_t line, bool error, const string& message) {
+			diagnostics[b].push_back({ line, error, (error ? "Error in Line " : "Warning in Line ")
+				+ std::to_string(line) + ": " + message });
+		};
+		size_t last = std::min(total, (b + 1) * BlockSize);
+		for (size_t k = b * BlockSize; k < last; ++k)
 		{
-			// Section 1: List of points
-			for (size_t pos = 0; pos < 2; ++pos)
+			const Line& line = lines[1 + k];
+			const char* p = line.begin;
+			bool extra = false;
+			if (k < specs[0])
 			{
-				iss >> coords[pos];
-				if (iss.fail())
+				// Section 1: List of points
+				double coords[3];
+				bool missing = false;
+				for (size_t pos = 0; pos < 2 && !missing; ++pos)
 				{
-					string message;
+					if (!scanNumber(p, line.end, coords[pos]))
 					{
-						stringstream sst;
-						sst << "Error in Line " << lineNumber
-							<< ": Missing coordinate " << pos;
-						message = sst.str();
+						report(line.number, true, "Missing coordinate " + std::to_string(pos));
+						missing = true;
 					}
-					_vInfo.push_back(message);
-					return isReady();
 				}
-			}
-
-			iss >> coords[2];
-			if (iss.fail())
-			{
-				// Spherical coordinates in degrees
-				Preimage pi(cs_deg2rad(coords[0]), cs_deg2rad(coords[1]));
-				_V.emplace_back(pi);
-			}
-			else
-			{
-				// Cartesian coordinates in degrees
-				Image im(coords[0], coords[1], coords[2]);
-				_V.emplace_back(im);
-			}
-
-			iss >> coords[3];
-			if (!iss.fail())
-			{
-				string message;
+				if (missing) continue;
+				if (!scanNumber(p, line.end, coords[2]))
 				{
-					stringstream sst;
-					sst << "Warning in Line " << lineNumber
-						<< ": Extra arguments are dropped";
-					message = sst.str();
+					// Spherical coordinates in degrees
+					_V[k] = Point(Preimage(cs_deg2rad(coords[0]), cs_deg2rad(coords[1])));
 				}
-				_vInfo.push_back(message);
-			}
-		}
-		else if (lineParsed <= specs[0] + specs[1])
-		{
-			// Section 2: List of edges
-			UndirectedEdge edge;
-			iss >> edge.first;
-			iss >> edge.second;
-			if (iss.fail())
-			{
-				string message;
+				else
 				{
-					stringstream sst;
-					sst << "Error in Line " << lineNumber
-						<< ": Edge specification missing point(s) ";
-					message = sst.str();
+					// Cartesian coordinates in degrees
+					_V[k] = Point(Image(coords[0], coords[1], coords[2]));
 				}
-				_vInfo.push_back(message);
-				return isReady();
+				extra = skipBlanks(p, line.end) != line.end;
 			}
-			_E.push_back(edge);
-
-			iss >> edge.first;
-			if (!iss.fail())
+			else if (k < specs[0] + specs[1])
 			{
-				string message;
+				// Section 2: List of edges
+				UndirectedEdge& edge = _E[k - specs[0]];
+				if (!scanNumber(p, line.end, edge.first) ||
+					!scanNumber(p, line.end, edge.second))
 				{
-					stringstream sst;
-					sst << "Warning in Line " << lineNumber
-						<< ": Extra arguments are dropped";
-					message = sst.str();
+					report(line.number, true, "Edge specification missing point(s) ");
+					continue;
 				}
-				_vInfo.push_back(message);
+				extra = skipBlanks(p, line.end) != line.end;
 			}
-		}
-		else if (lineParsed <= specs[0] + specs[1] + specs[2])
-		{
-			// Section 3: List of triangles
-			size_t indices[3];
-			char orientation[3] = { '\0', '\0', '\0' };
-
-			for (size_t pos = 0; pos < 3; ++pos)
+			else
 			{
-				iss >> orientation[pos];
-				if (iss.fail() || orientation[0] == '\0')
+				// Section 3: List of triangles
+				DirectedEdge edges[3];
+				bool malformed = false;
+				for (size_t pos = 0; pos < 3 && !malformed; ++pos)
 				{
-					string message;
+					p = skipBlanks(p, line.end);
+					if (p == line.end || (*p != '+' && *p != '-'))
 					{
-						stringstream sst;
-						sst << "Error in Line " << lineNumber
-							<< ": Argument " << pos
-							<< " is missing an orientation";
-						message = sst.str();
+						report(line.number, true, "Argument " + std::to_string(pos)
+							+ " is missing an orientation");
+						malformed = true;
+						break;
 					}
-					_vInfo.push_back(message);
-				}
-				iss >> indices[pos];
-				if (iss.fail() || orientation[0] == '\0')
-				{
-					string message;
+					edges[pos].second = *p++ == '+';
+					if (p == line.end || *p == ' ' || *p == '\t' ||
+						!scanNumber(p, line.end, edges[pos].first))
 					{
-						stringstream sst;
-						sst << "Error in Line " << lineNumber
-							<< ": Argument " << pos
-							<< " is not formatted correctly";
-						message = sst.str();
+						report(line.number, true, "Argument " + std::to_string(pos)
+							+ " is not formatted correctly");
+						malformed = true;
 					}
-					_vInfo.push_back(message);
 				}
+				if (malformed) continue;
+				_F[k - specs[0] - specs[1]] = DirectedEdgeTriplet(edges[0], edges[1], edges[2]);
+				extra = skipBlanks(p, line.end) != line.end;
 			}
-
-			_F.emplace_back(
-				std::make_pair(indices[0], orientation[0] == '+'),
-				std::make_pair(indices[1], orientation[1] == '+'),
-				std::make_pair(indices[2], orientation[2] == '+'));
-
-			iss >> orientation[0];
-			if (!iss.fail())
+			if (extra)
 			{
-				string message;
-				{
-					stringstream sst;
-					sst << "Warning in Line " << lineNumber
-						<< ": Extra arguments are dropped";
-					message = sst.str();
-				}
-				_vInfo.push_back(message);
+				report(line.number, false, "Extra arguments are dropped");
 			}
 		}
+	}
 
-		++lineParsed;
-		iss.clear();
+	// 4. Merge diagnostics, stopping at the first error
+	for (auto& block : diagnostics)
+	{
+		for (auto& diagnostic : block)
+		{
+			_vInfo.push_back(std::move(diagnostic.message));
+			if (diagnostic.error)
+			{
+				_V.clear();
+				_E.clear();
+				_F.clear();
+				return isReady();
+			}
+		}
 	}
 
 	_bLoadSuccess = true;
@@ -1064,8 +1716,13 @@ Cartosphere::TriangularMesh::load(const string& path)
 }
 
 bool
-Cartosphere::TriangularMesh::save(const string& path) const
+Cartosphere::TriangularMesh::save(const string& path, bool redundant) const
 {
+	if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".csmb") == 0)
+	{
+		return _save_binary(path, redundant);
+	}
+
 	ofstream ofs(path);
 
 	if (!ofs.is_open())
@@ -1112,112 +1769,581 @@ Cartosphere::TriangularMesh::save(const string& path) const
 }
 
 bool
-Cartosphere::TriangularMesh::format(const string& path,
-	const vector<double>& values) const
+Cartosphere::TriangularMesh::_load_binary(const string& path)
 {
-	// Summary of Logic:
-	//   1. Mark all used edges
-	//   2. Generate UV sphere (material globe)
-	//   3. Generate Segmented Edges (material segment)
-	//   4. Generate triangulated faces (material color) if values are provided
-	//      - The entire mesh is refined
-	//   5. Format Wavefront OBJ output file
-
-	// Export to specified path
-	ofstream ofs(path);
-	if (!ofs.is_open()) return false;
-
-	// Mark all edges that are part of some triangle
-	vector<bool> edgeUsages(_E.size(), false);
-	for (auto& triangle : _F)
+	MappedFile file(path);
+	if (file.data == nullptr)
 	{
-		edgeUsages[std::get<0>(triangle).first] = true;
-		edgeUsages[std::get<1>(triangle).first] = true;
-		edgeUsages[std::get<2>(triangle).first] = true;
+		string message;
+		{
+			stringstream sst;
+			sst << "Could not load path " << path;
+			message = sst.str();
+		}
+		_vInfo.push_back(message);
+		return isReady();
 	}
 
-	// Initialize container for obj vertices and smoothing groups
-	vector<Image> vs;
-	vector<int> cs;
-	vector<vector<vector<size_t>>> sgs;
-	vector<string> materials;
-	vector<size_t> list;
+	// Sections are padded to 8 bytes, so arrays can be read in place
+	// Sizes are counts from the file, checked against the remaining bytes
+	// before they are multiplied so that corrupt counts cannot overflow
+	size_t at = 0;
+	bool truncated = false;
+	auto take = [&file, &at, &truncated](size_t n, size_t size) -> const char* {
+		if (truncated || (size > 0 && n > (file.size - at) / size))
+		{
+			truncated = true;
+			return nullptr;
+		}
+		size_t padded = (n * size + 7) & ~(size_t)7;
+		if (file.size - at < padded)
+		{
+			truncated = true;
+			return nullptr;
+		}
+		const char* p = file.data + at;
+		at += padded;
+		return p;
+	};
+	auto read = [&take](auto& value) {
+		const char* p = take(1, sizeof(value));
+		if (p) std::memcpy(&value, p, sizeof(value));
+	};
+	auto read_array = [&take](auto& values, size_t n) {
+		typedef typename std::decay_t<decltype(values)>::value_type T;
+		static_assert(std::is_trivially_copyable_v<T>, "Use read_vectors");
+		const char* p = take(n, sizeof(T));
+		values.resize(p ? n : 0);
+		if (p) std::memcpy(values.data(), p, n * sizeof(T));
+	};
+	// FL3 is not trivially copyable, so vectors are built from components
+	auto read_vectors = [&take](vector<FL3>& values, size_t n) {
+		const double* p = (const double*)take(n, 3 * sizeof(double));
+		values.resize(p ? n : 0);
+		for (size_t i = 0; p && i < n; ++i)
+		{
+			values[i] = FL3(p[3 * i], p[3 * i + 1], p[3 * i + 2]);
+		}
+	};
+	auto fail = [this, &path](const string& reason) {
+		clear();
+		_vInfo.push_back("Error in " + path + ": " + reason);
+		return isReady();
+	};
+
+	// Header: magic, version, flags and index width, then V, E and F
+	std::uint32_t header[4] = {};
+	std::uint64_t sizes[3] = {};
+	read(header);
+	read(sizes);
+	std::uint32_t flags = header[2], indexBytes = header[3];
+	std::uint64_t V = sizes[0], E = sizes[1], F = sizes[2];
+	if (truncated || header[0] != BinaryMagic || header[1] != BinaryVersion)
+	{
+		return fail("Binary mesh format is unrecognized");
+	}
 
-	// [Color] Subdivide [0,1] into 256 colors
-	vector<double> table;
-	if (!values.empty())
+	// Vertices as unit vectors
+	const double* xyz = (const double*)take(V, 3 * sizeof(double));
+	// Edges as pairs of vertex indices
+	const std::uint64_t* edges = (const std::uint64_t*)take(E, 2 * sizeof(std::uint64_t));
+	// Faces as edge indices shifted left, with the orientation in the lowest bit
+	const std::uint64_t* faces = (const std::uint64_t*)take(F, 3 * sizeof(std::uint64_t));
+	if (truncated)
 	{
-		table.resize(256);
-		for (size_t k = 0; k < table.size(); ++k)
+		return fail("Binary mesh is truncated");
+	}
+	if (V > (std::uint64_t)std::numeric_limits<int>::max())
+	{
+		return fail("Binary mesh has too many points");
+	}
+	_V.resize(V);
+#pragma omp parallel for if (V >= 1024) num_threads(ThreadsMaximum)
+	for (int i = 0; i < (int)V; ++i)
+	{
+		_V[i] = Point(Image(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]));
+	}
+	_E.resize(E);
+	for (size_t k = 0; k < E; ++k)
+	{
+		if (edges[2 * k] >= V || edges[2 * k + 1] >= V)
 		{
-			table[k] = double(1) * k / table.size();
+			return fail("Edge refers to a missing point");
+		}
+		_E[k] = UndirectedEdge(edges[2 * k], edges[2 * k + 1]);
+	}
+	_F.resize(F);
+	for (size_t k = 0; k < F; ++k)
+	{
+		const std::uint64_t* f = faces + 3 * k;
+		if ((f[0] >> 1) >= E || (f[1] >> 1) >= E || (f[2] >> 1) >= E)
+		{
+			return fail("Face refers to a missing edge");
 		}
+		_F[k] = DirectedEdgeTriplet(
+			DirectedEdge(f[0] >> 1, f[0] & 1),
+			DirectedEdge(f[1] >> 1, f[1] & 1),
+			DirectedEdge(f[2] >> 1, f[2] & 1));
 	}
+	_bLoadSuccess = true;
 
-	// Push vertices and edges for a globe
+	// Redundant states stored with other index widths are rebuilt instead
+	if (!(flags & BinaryRedundant) || indexBytes != sizeof(Index))
 	{
-		// Preparation for vertices at certain UV detail level
-		const size_t uv = 64;
-		const double radius = 0.999;
+		_populate();
+		return isReady();
+	}
 
-		// Vertex: north pole
-		vs.emplace_back(0, 0, radius);
+	// The redundant state is only trusted once every index in it is in
+	// range; otherwise it is rebuilt from the vertices, edges and faces
+	auto rebuild = [this](const string& reason) {
+		_vInfo.push_back("Redundant state rebuilt: " + reason);
+		_tree.clear();
+		_populate();
+		return isReady();
+	};
+
+	// Connectivity
+	read_array(_FV, F);
+	read_array(_FF, F);
+	read_array(_VE.offsets, V + 1);
+	read_array(_VE.items, E);
+	read_array(_VF.offsets, V + 1);
+	read_array(_VF.items, 3 * F);
+	std::uint64_t colours = 0;
+	read(colours);
+	if (colours > F)
+	{
+		return rebuild("Too many colours");
+	}
+	read_array(_FC.offsets, colours + 1);
+	read_array(_FC.items, F);
 
-		// Vertex: all points but the poles
-		double x, y, z, a, p;
-		for (size_t k = 1; k < uv; ++k)
+	// Geometry
+	read_array(_FA, F);
+	read_vectors(_FP, 3 * F);
+
+	// Sparsity pattern and slots
+	std::uint64_t nonZeros = 0;
+	read(nonZeros);
+	if (nonZeros > (std::uint64_t)std::numeric_limits<int>::max())
+	{
+		return rebuild("Too many non-zeros");
+	}
+	vector<int> outer, inner;
+	read_array(outer, V + 1);
+	read_array(inner, nonZeros);
+	read_array(_slots, 9 * F);
+
+	// SS-tree, one record of seven words per node
+	std::uint64_t height = 0, nodes = 0;
+	read(height);
+	read(nodes);
+	const char* records = take(nodes, 7 * sizeof(std::uint64_t));
+	vector<std::uint64_t> entries;
+	read_array(entries, F);
+	if (truncated)
+	{
+		return rebuild("Binary mesh is truncated");
+	}
+
+	_tree.clear();
+	_tree._height = height;
+	_tree._nodes.resize(nodes);
+	for (size_t n = 0; n < nodes; ++n)
+	{
+		double real[4];
+		std::uint64_t integer[3];
+		std::memcpy(real, records + 56 * n, sizeof(real));
+		std::memcpy(integer, records + 56 * n + 32, sizeof(integer));
+		Tree::Node& node = _tree._nodes[n];
+		node.apex = FL3(real[0], real[1], real[2]);
+		node.cos_radius = real[3];
+		node.first = integer[0];
+		node.count = integer[1];
+		node.leaf = integer[2] != 0;
+	}
+	_tree._entries.assign(entries.begin(), entries.end());
+
+	string reason = _check_redundant(outer, inner);
+	if (!reason.empty())
+	{
+		return rebuild(reason);
+	}
+
+	_pattern.resize((int)V, (int)V);
+	_pattern.resizeNonZeros((Eigen::Index)nonZeros);
+	std::copy(outer.begin(), outer.end(), _pattern.outerIndexPtr());
+	std::copy(inner.begin(), inner.end(), _pattern.innerIndexPtr());
+	std::fill(_pattern.valuePtr(), _pattern.valuePtr() + nonZeros, 0.0);
+
+	_bParseSuccess = true;
+	return isReady();
+}
+
+string
+Cartosphere::TriangularMesh::_check_redundant(const vector<int>& outer,
+	const vector<int>& inner) const
+{
+	size_t V = _V.size(), E = _E.size(), F = _F.size();
+
+	// Lists of indices below a bound, with offsets from 0 to the item count
+	auto listed = [](const Adjacency& lists, size_t count, size_t bound) {
+		const vector<Index>& offsets = lists.offsets;
+		if (offsets.size() != count + 1 || offsets.front() != 0
+			|| offsets.back() != lists.items.size())
 		{
-			p = M_PI * k / uv;
-			z = radius * cos(p);
-			for (size_t j = 0; j < uv; ++j)
+			return false;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (offsets[i] > offsets[i + 1])
 			{
-				x = y = radius * sin(p);
-				a = 2 * M_PI * j / uv;
-				x *= cos(a);
-				y *= sin(a);
-				vs.emplace_back(x, y, z);
+				return false;
 			}
 		}
-		// Vertex: south pole
-		vs.emplace_back(0, 0, -radius);
-
-		// Preparation for faces and smoothing group
-		materials.emplace_back("globe");
-		sgs.emplace_back();
-		auto& sg = sgs.back();
-
-		// Face: cap at north pole
-		for (size_t j = 0; j < uv; ++j)
+		for (Index item : lists.items)
 		{
-			list = {
-				1,
-				2 + j,
-				2 + (j + 1) % uv
-			};
-			sg.push_back(list);
+			if (item >= bound)
+			{
+				return false;
+			}
 		}
+		return true;
+	};
 
-		// Face: quad strips
-		for (size_t k = 1; k < uv - 1; ++k)
+	// Connectivity
+	for (size_t k = 0; k < F; ++k)
+	{
+		for (int i = 0; i < 3; ++i)
 		{
-			for (size_t j = 0; j < uv; ++j)
+			if (_FV[k][i] >= V || (_FF[k][i] >= F && _FF[k][i] != NoIndex))
 			{
-				list = {
-					2 + uv * (k - 1) + j,
-					2 + uv * k + j,
-					2 + uv * k + (j + 1) % uv,
-					2 + uv * (k - 1) + (j + 1) % uv
-				};
-				sg.push_back(list);
+				return "Face refers to a missing point or face";
 			}
 		}
+	}
+	if (!listed(_VE, V, E) || !listed(_VF, V, F))
+	{
+		return "Vertex incidence is malformed";
+	}
 
-		// Face: cap at south pole
-		for (size_t j = 0; j < uv; ++j)
+	// Every face has one colour, and faces of a colour share no vertex,
+	// since the colours are assembled in parallel
+	if (_FC.offsets.empty() || !listed(_FC, _FC.offsets.size() - 1, F))
+	{
+		return "Colouring is malformed";
+	}
+	vector<char> coloured(F, 0);
+	vector<size_t> stamp(V, (size_t)-1);
+	for (size_t c = 0; c < _FC.size(); ++c)
+	{
+		for (Index k : _FC[c])
 		{
-			list = {
-				2 + uv * (uv - 2) + j,
-				2 + uv * (uv - 1),
+			if (coloured[k])
+			{
+				return "Colouring repeats a face";
+			}
+			coloured[k] = 1;
+			for (Index v : _FV[k])
+			{
+				if (stamp[v] == c)
+				{
+					return "Colouring has adjacent faces";
+				}
+				stamp[v] = c;
+			}
+		}
+	}
+
+	// Rows of the pattern hold sorted columns, and each slot points at the
+	// entry of its row and column
+	size_t nonZeros = inner.size();
+	if (outer.size() != V + 1 || outer.front() != 0 || (size_t)outer.back() != nonZeros)
+	{
+		return "Sparsity pattern is malformed";
+	}
+	for (size_t i = 0; i < V; ++i)
+	{
+		if (outer[i] > outer[i + 1])
+		{
+			return "Sparsity pattern is malformed";
+		}
+	}
+	for (size_t i = 0; i < V; ++i)
+	{
+		for (int n = outer[i]; n < outer[i + 1]; ++n)
+		{
+			if (inner[n] < 0 || (size_t)inner[n] >= V
+				|| (n > outer[i] && inner[n - 1] >= inner[n]))
+			{
+				return "Sparsity pattern is malformed";
+			}
+		}
+	}
+	for (size_t k = 0; k < F; ++k)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				int slot = _slots[9 * k + 3 * i + j];
+				Index row = _FV[k][i];
+				if (slot < outer[row] || slot >= outer[row + 1]
+					|| (Index)inner[slot] != _FV[k][j])
+				{
+					return "Slots do not match the sparsity pattern";
+				}
+			}
+		}
+	}
+
+	// Children follow their parent, so the tree has no cycle, and the search
+	// stack holds M entries per level
+	const vector<Tree::Node>& nodes = _tree._nodes;
+	const size_t entries = _tree._entries.size();
+	vector<size_t> depth(nodes.size(), 1);
+	for (size_t n = 0; n < nodes.size(); ++n)
+	{
+		const Tree::Node& node = nodes[n];
+		if (node.leaf)
+		{
+			if (node.count > entries || node.first > entries - node.count)
+			{
+				return "Tree refers to missing entries";
+			}
+			continue;
+		}
+		if (node.count > Tree::M || node.first <= n
+			|| node.first > nodes.size() - node.count)
+		{
+			return "Tree refers to missing nodes";
+		}
+		for (size_t c = node.first; c < node.first + node.count; ++c)
+		{
+			depth[c] = std::max(depth[c], depth[n] + 1);
+			if (depth[c] > 64)
+			{
+				return "Tree is too deep";
+			}
+		}
+	}
+	for (size_t entry : _tree._entries)
+	{
+		if (entry >= F)
+		{
+			return "Tree refers to a missing face";
+		}
+	}
+	return string();
+}
+
+bool
+Cartosphere::TriangularMesh::_save_binary(const string& path, bool redundant) const
+{
+	ofstream ofs(path, std::ios::binary);
+	if (!ofs.is_open())
+	{
+		return false;
+	}
+
+	// Sections are padded to 8 bytes, so arrays can be read in place
+	auto write = [&ofs](const void* data, size_t bytes) {
+		static const char zeros[8] = {};
+		ofs.write((const char*)data, bytes);
+		ofs.write(zeros, ((bytes + 7) & ~(size_t)7) - bytes);
+	};
+	auto write_value = [&write](auto value) {
+		write(&value, sizeof(value));
+	};
+	auto write_array = [&write](const auto& values) {
+		write(values.data(), values.size() * sizeof(values[0]));
+	};
+
+	// Header
+	redundant = redundant && _bParseSuccess;
+	std::uint32_t header[4] = { BinaryMagic, BinaryVersion,
+		redundant ? BinaryRedundant : 0, (std::uint32_t)sizeof(Index) };
+	std::uint64_t sizes[3] = { _V.size(), _E.size(), _F.size() };
+	ofs.write((const char*)header, sizeof(header));
+	ofs.write((const char*)sizes, sizeof(sizes));
+
+	// Vertices, edges and faces
+	vector<double> xyz(3 * _V.size());
+	for (size_t i = 0; i < _V.size(); ++i)
+	{
+		xyz[3 * i] = _V[i].x();
+		xyz[3 * i + 1] = _V[i].y();
+		xyz[3 * i + 2] = _V[i].z();
+	}
+	write_array(xyz);
+	vector<std::uint64_t> indices(2 * _E.size());
+	for (size_t k = 0; k < _E.size(); ++k)
+	{
+		indices[2 * k] = _E[k].first;
+		indices[2 * k + 1] = _E[k].second;
+	}
+	write_array(indices);
+	indices.resize(3 * _F.size());
+	for (size_t k = 0; k < _F.size(); ++k)
+	{
+		const DirectedEdge edges[3] = {
+			std::get<0>(_F[k]), std::get<1>(_F[k]), std::get<2>(_F[k])
+		};
+		for (size_t i = 0; i < 3; ++i)
+		{
+			indices[3 * k + i] = ((std::uint64_t)edges[i].first << 1) | edges[i].second;
+		}
+	}
+	write_array(indices);
+
+	if (redundant)
+	{
+		// Connectivity
+		write_array(_FV);
+		write_array(_FF);
+		write_array(_VE.offsets);
+		write_array(_VE.items);
+		write_array(_VF.offsets);
+		write_array(_VF.items);
+		write_value((std::uint64_t)_FC.size());
+		write_array(_FC.offsets);
+		write_array(_FC.items);
+
+		// Geometry
+		write_array(_FA);
+		write_array(_FP);
+
+		// Sparsity pattern and slots
+		write_value((std::uint64_t)_pattern.nonZeros());
+		write(_pattern.outerIndexPtr(), (_V.size() + 1) * sizeof(int));
+		write(_pattern.innerIndexPtr(), _pattern.nonZeros() * sizeof(int));
+		write_array(_slots);
+
+		// SS-tree, one record of seven words per node
+		write_value((std::uint64_t)_tree._height);
+		write_value((std::uint64_t)_tree._nodes.size());
+		for (const auto& node : _tree._nodes)
+		{
+			double real[4] = { node.apex.x, node.apex.y, node.apex.z, node.cos_radius };
+			std::uint64_t integer[3] = { node.first, node.count, node.leaf };
+			ofs.write((const char*)real, sizeof(real));
+			ofs.write((const char*)integer, sizeof(integer));
+		}
+		vector<std::uint64_t> entries(_tree._entries.begin(), _tree._entries.end());
+		write_array(entries);
+	}
+
+	return ofs.good();
+}
+
+bool
+Cartosphere::TriangularMesh::format(const string& path,
+	const vector<double>& values) const
+{
+	// Summary of Logic:
+	//   1. Mark all used edges
+	//   2. Generate UV sphere (material globe)
+	//   3. Generate Segmented Edges (material segment)
+	//   4. Generate triangulated faces (material color) if values are provided
+	//      - The entire mesh is refined
+	//   5. Format Wavefront OBJ output file
+
+	// Export to specified path
+	ofstream ofs(path);
+	if (!ofs.is_open()) return false;
+
+	// Mark all edges that are part of some triangle
+	vector<bool> edgeUsages(_E.size(), false);
+	for (auto& triangle : _F)
+	{
+		edgeUsages[std::get<0>(triangle).first] = true;
+		edgeUsages[std::get<1>(triangle).first] = true;
+		edgeUsages[std::get<2>(triangle).first] = true;
+	}
+
+	// Initialize container for obj vertices and smoothing groups
+	vector<Image> vs;
+	vector<int> cs;
+	vector<vector<vector<size_t>>> sgs;
+	vector<string> materials;
+	vector<size_t> list;
+
+	// [Color] Subdivide [0,1] into 256 colors
+	vector<double> table;
+	if (!values.empty())
+	{
+		table.resize(256);
+		for (size_t k = 0; k < table.size(); ++k)
+		{
+			table[k] = double(1) * k / table.size();
+		}
+	}
+
+	// Push vertices and edges for a globe
+	{
+		// Preparation for vertices at certain UV detail level
+		const size_t uv = 64;
+		const double radius = 0.999;
+
+		// Vertex: north pole
+		vs.emplace_back(0, 0, radius);
+
+		// Vertex: all points but the poles
+		double x, y, z, a, p;
+		for (size_t k = 1; k < uv; ++k)
+		{
+			p = M_PI * k / uv;
+			z = radius * cos(p);
+			for (size_t j = 0; j < uv; ++j)
+			{
+				x = y = radius * sin(p);
+				a = 2 * M_PI * j / uv;
+				x *= cos(a);
+				y *= sin(a);
+				vs.emplace_back(x, y, z);
+			}
+		}
+		// Vertex: south pole
+		vs.emplace_back(0, 0, -radius);
+
+		// Preparation for faces and smoothing group
+		materials.emplace_back("globe");
+		sgs.emplace_back();
+		auto& sg = sgs.back();
+
+		// Face: cap at north pole
+		for (size_t j = 0; j < uv; ++j)
+		{
+			list = {
+				1,
+				2 + j,
+				2 + (j + 1) % uv
+			};
+			sg.push_back(list);
+		}
+
+		// Face: quad strips
+		for (size_t k = 1; k < uv - 1; ++k)
+		{
+			for (size_t j = 0; j < uv; ++j)
+			{
+				list = {
+					2 + uv * (k - 1) + j,
+					2 + uv * k + j,
+					2 + uv * k + (j + 1) % uv,
+					2 + uv * (k - 1) + (j + 1) % uv
+				};
+				sg.push_back(list);
+			}
+		}
+
+		// Face: cap at south pole
+		for (size_t j = 0; j < uv; ++j)
+		{
+			list = {
+				2 + uv * (uv - 2) + j,
+				2 + uv * (uv - 1),
 				2 + uv * (uv - 2) + (j + 1) % uv
 			};
 			sg.push_back(list);
@@ -1521,103 +2647,152 @@ Cartosphere::TriangularMesh::formatPoly(
 	return true;
 }
 
-void
-Cartosphere::TriangularMesh::refine()
+bool
+Cartosphere::TriangularMesh::_subdivide()
 {
 	// Update VEF count, as a special case with division set to 2
-	size_t V = _V.size() + _E.size();
-	size_t E = 2 * _E.size() + 3 * _F.size();
-	size_t F = 4 * _F.size();
-
-	auto edges = std::move(_E);
-	auto triangles = std::move(_F);
-
-	_V.reserve(V);
-	_E.reserve(E);
-	_F.reserve(F);
-
-	// Each old edge will produce one new midpoint
-	for (auto& pair : edges)
+	size_t V0 = _V.size(), E0 = _E.size(), F0 = _F.size();
+	size_t V = V0 + E0;
+	size_t E = 2 * E0 + 3 * F0;
+	size_t F = 4 * F0;
+
+	// Every output has a known position, so all are filled in parallel:
+	// - the midpoint of edge e is vertex V0 + e,
+	// - edge e is bisected into edges 2e and 2e + 1,
+	// - face f has inner edges 2E0 + 3f + k and children 4f + k
+	_V.resize(V);
+	vector<UndirectedEdge> edges(E);
+#pragma omp parallel for if (E0 >= 1024) num_threads(ThreadsMaximum)
+	for (int e = 0; e < (int)E0; ++e)
 	{
-		const Point& A = _V[pair.first];
-		const Point& B = _V[pair.second];
-
-		size_t midpointIndex = _V.size();
-		_V.push_back(midpoint(A, B));
-
-		// Each new midpoint will bisect the old edge into two new edges
-		_E.emplace_back(std::make_pair(pair.first, midpointIndex));
-		_E.emplace_back(std::make_pair(midpointIndex, pair.second));
+		size_t m = V0 + e;
+		_V[m] = midpoint(_V[_E[e].first], _V[_E[e].second]);
+		edges[2 * e] = std::make_pair(_E[e].first, m);
+		edges[2 * e + 1] = std::make_pair(m, _E[e].second);
 	}
-
-	// Assemble new list of triangles
-	size_t myMidpoints[3];
-	vector<DirectedEdge> myEdges;
-	vector<DirectedEdgeTriplet> myTriangles;
-	myEdges.reserve(12);
-	myTriangles.reserve(4);
-	for (auto& triangle : triangles)
+	vector<DirectedEdgeTriplet> triangles(F);
+#pragma omp parallel for if (F0 >= 1024) num_threads(ThreadsMaximum)
+	for (int f = 0; f < (int)F0; ++f)
 	{
-		auto& a = std::get<0>(triangle);
-		auto& b = std::get<1>(triangle);
-		auto& c = std::get<2>(triangle);
-		// Push 6 constructed edges and retrieve midpoints
-		myEdges.emplace_back(2 * a.first, a.second);
-		myEdges.emplace_back(2 * a.first + 1, a.second);
-		if (!a.second)
-			std::swap(myEdges[0], myEdges[1]);
-
-		myEdges.emplace_back(2 * b.first, b.second);
-		myEdges.emplace_back(2 * b.first + 1, b.second);
-		if (!b.second)
-			std::swap(myEdges[2], myEdges[3]);
-
-		myEdges.emplace_back(2 * c.first, c.second);
-		myEdges.emplace_back(2 * c.first + 1, c.second);
-		if (!c.second)
-			std::swap(myEdges[4], myEdges[5]);
-
-		// Retrieve the midpoints
-		if (myEdges[0].second)
-			myMidpoints[0] = _E[myEdges[0].first].second;
-		else
-			myMidpoints[0] = _E[myEdges[0].first].first;
-
-		if (myEdges[2].second)
-			myMidpoints[1] = _E[myEdges[2].first].second;
-		else
-			myMidpoints[1] = _E[myEdges[2].first].first;
+		const DirectedEdge parent[3] = {
+			std::get<0>(_F[f]), std::get<1>(_F[f]), std::get<2>(_F[f])
+		};
+		// Halves of the old edges in the direction of the face, and the
+		// midpoints of the old edges
+		DirectedEdge halves[6];
+		size_t midpoints[3];
+		for (size_t i = 0; i < 3; ++i)
+		{
+			halves[2 * i] = DirectedEdge(2 * parent[i].first, parent[i].second);
+			halves[2 * i + 1] = DirectedEdge(2 * parent[i].first + 1, parent[i].second);
+			if (!parent[i].second)
+			{
+				std::swap(halves[2 * i], halves[2 * i + 1]);
+			}
+			midpoints[i] = V0 + parent[i].first;
+		}
 
-		if (myEdges[4].second)
-			myMidpoints[2] = _E[myEdges[4].first].second;
-		else
-			myMidpoints[2] = _E[myEdges[4].first].first;
+		// Three new edges between the midpoints
+		size_t inner = 2 * E0 + 3 * f;
+		edges[inner] = std::make_pair(midpoints[0], midpoints[2]);
+		edges[inner + 1] = std::make_pair(midpoints[1], midpoints[0]);
+		edges[inner + 2] = std::make_pair(midpoints[2], midpoints[1]);
+
+		// Four new triangles per old triangle
+		triangles[4 * f] = DirectedEdgeTriplet(halves[0],
+			DirectedEdge(inner, true), halves[5]);
+		triangles[4 * f + 1] = DirectedEdgeTriplet(halves[1], halves[2],
+			DirectedEdge(inner + 1, true));
+		triangles[4 * f + 2] = DirectedEdgeTriplet(DirectedEdge(inner + 2, true),
+			halves[3], halves[4]);
+		triangles[4 * f + 3] = DirectedEdgeTriplet(DirectedEdge(inner, false),
+			DirectedEdge(inner + 1, false), DirectedEdge(inner + 2, false));
+	}
+	_E.swap(edges);
+	_F.swap(triangles);
+	vector<UndirectedEdge>().swap(edges);
+	vector<DirectedEdgeTriplet>().swap(triangles);
 
-		// Push six new edges from the three new midpoints per triangle
-		myEdges.emplace_back(_E.size(), true);
-		myEdges.emplace_back(_E.size(), false);
-		_E.push_back(std::make_pair(myMidpoints[0], myMidpoints[2]));
+	if (!_bParseSuccess || _FV.size() != F0)
+	{
+		return false;
+	}
 
-		myEdges.emplace_back(_E.size(), true);
-		myEdges.emplace_back(_E.size(), false);
-		_E.push_back(std::make_pair(myMidpoints[1], myMidpoints[0]));
+	// Update the vertices and neighbours of the faces from their parents
+	// The children of face (A, B, C) with midpoints m0 on AB, m1 on BC and
+	// m2 on CA are (A, m0, m2), (m0, B, m1), (m2, m1, C) and (m2, m0, m1)
+	// Corner child i has the central child across its edge opposite vertex i,
+	// and across its other edges the corner children of the neighbours at
+	// the same vertex
+	vector<IndexTriplet> FV(F), FF(F);
+#pragma omp parallel for if (F0 >= 1024) num_threads(ThreadsMaximum)
+	for (int f = 0; f < (int)F0; ++f)
+	{
+		const IndexTriplet& v = _FV[f];
+		// The midpoints start the inner edges
+		size_t inner = 2 * E0 + 3 * f;
+		Index m[3] = {
+			(Index)_E[inner].first, (Index)_E[inner + 1].first, (Index)_E[inner + 2].first
+		};
+		FV[4 * f] = { v[0], m[0], m[2] };
+		FV[4 * f + 1] = { m[0], v[1], m[1] };
+		FV[4 * f + 2] = { m[2], m[1], v[2] };
+		FV[4 * f + 3] = { m[2], m[0], m[1] };
+		Index center = (Index)(4 * f + 3);
+		FF[center] = { (Index)(4 * f + 1), (Index)(4 * f + 2), (Index)(4 * f) };
+		for (size_t i = 0; i < 3; ++i)
+		{
+			Index corner = (Index)(4 * f + i);
+			for (size_t j = 0; j < 3; ++j)
+			{
+				Index n = _FF[f][j];
+				if (j == i)
+				{
+					FF[corner][j] = center;
+				}
+				else if (n == NoIndex)
+				{
+					FF[corner][j] = NoIndex;
+				}
+				else
+				{
+					const IndexTriplet& w = _FV[n];
+					Index k = (Index)(std::find(w.begin(), w.end(), v[i]) - w.begin());
+					FF[corner][j] = 4 * n + k;
+				}
+			}
+		}
+	}
+	_FV.swap(FV);
+	_FF.swap(FF);
+	vector<IndexTriplet>().swap(FV);
+	vector<IndexTriplet>().swap(FF);
+	return true;
+}
 
-		myEdges.emplace_back(_E.size(), true);
-		myEdges.emplace_back(_E.size(), false);
-		_E.push_back(std::make_pair(myMidpoints[2], myMidpoints[1]));
+void
+Cartosphere::TriangularMesh::refine()
+{
+	// Mid-point refinement does not follow newest-vertex bisection
+	_VB.clear();
 
-		// Construct four new triangles per old triangle
-		_F.emplace_back(myEdges[0], myEdges[6], myEdges[5]);
-		_F.emplace_back(myEdges[1], myEdges[2], myEdges[8]);
-		_F.emplace_back(myEdges[10], myEdges[3], myEdges[4]);
-		_F.emplace_back(myEdges[7], myEdges[9], myEdges[11]);
+	// Keep the vertices of the coarse faces
+	if (_bHierarchy)
+	{
+		_retain_level();
+	}
 
-		myEdges.clear();
-		myTriangles.clear();
+	// Meshes that failed to populate are populated from scratch
+	if (!_subdivide())
+	{
+		_populate();
+		return;
 	}
 
-	// Fill the simplices
-	_populate();
+	// Refresh the rest, and split the leaves of the tree
+	_populate_geometry();
+	_populate_incidence();
+	_tree.refine(*this);
 }
 
 void
@@ -1635,240 +2810,872 @@ Cartosphere::TriangularMesh::refine(size_t division)
 	}
 
 	// Update VEF count: original (V', E', F') -> refined (V, E, F)
-	// V = V' + (d-1)E' + (d-1)(d-2)/2
+	// V = V' + (d-1)E' + F'(d-1)(d-2)/2
 	// E = d*E' + 3F'd(d-1)/2
 	// F = ddF';
-	size_t V = _V.size()
-		+ (division - 1) * _E.size()
-		+ (division - 1) * (division - 2) / 2;
-	size_t E = division * _E.size()
-		+ 3 * _F.size() * division * (division - 1) / 2;
-	size_t F = division * division * _F.size();
-
-	// Preserve edges and triangles
-	auto edges = std::move(_E);
-	auto triangles = std::move(_F);
-
-	// Reserve (perhaps more) memory
-	_V.reserve(V);
-	_E.reserve(E);
-	_F.reserve(F);
+	const size_t d = division;
+	size_t V0 = _V.size(), E0 = _E.size(), F0 = _F.size();
+	size_t VI = (d - 1) * (d - 2) / 2;
+	size_t EI = 3 * d * (d - 1) / 2;
+	size_t V = V0 + (d - 1) * E0 + VI * F0;
+	size_t E = d * E0 + EI * F0;
+	size_t F = d * d * F0;
+
+	// Faces no longer have four children each
+	retainHierarchy(false);
+	_VB.clear();
+
+	// Each face (A, B, C) is divided along the lattice of points
+	// (aA + bB + cC) / d, with a + b + c = d, projected onto the sphere, and
+	// every output has a known position:
+	// - point t of edge e, from its first vertex, is vertex V0 + (d-1)e + t-1
+	// - interior point (b, c) of face f is vertex V0 + (d-1)E0 + VI*f + ...
+	// - segment t of edge e is edge de + t
+	// - interior edges of face f are edges dE0 + EI*f + ..., first those
+	//   along AB, then along AC, then along BC
+	// - the children of face f are faces ddf to ddf + dd - 1
+	auto interiorPoint = [d](size_t b, size_t c) {
+		return (c - 1) * (d - 1) - (c - 1) * c / 2 + (b - 1);
+	};
+	auto edgeAB = [d](size_t b, size_t c) {
+		return (c - 1) * d - (c - 1) * c / 2 + b;
+	};
+	auto edgeAC = [d](size_t b, size_t c) {
+		return d * (d - 1) / 2 + (b - 1) * d - (b - 1) * b / 2 + c;
+	};
+	auto edgeBC = [d](size_t b, size_t c) {
+		return d * (d - 1) + c * (d - 1) - c * (c - 1) / 2 + b;
+	};
+	auto lerp = [d](const Point& P, const Point& Q, size_t t) {
+		return Point(Image(normalize(P.image() * (double)(d - t) + Q.image() * (double)t)));
+	};
+
+	// Points and segments of the old edges
+	_V.resize(V);
+	vector<UndirectedEdge> edges(E);
+#pragma omp parallel for if (E0 >= 1024) num_threads(ThreadsMaximum)
+	for (int e = 0; e < (int)E0; ++e)
+	{
+		size_t first = _E[e].first, second = _E[e].second;
+		size_t previous = first;
+		for (size_t t = 1; t <= d; ++t)
+		{
+			size_t next = t < d ? V0 + (d - 1) * e + t - 1 : second;
+			if (t < d)
+			{
+				_V[next] = lerp(_V[first], _V[second], t);
+			}
+			edges[d * e + t - 1] = std::make_pair(previous, next);
+			previous = next;
+		}
+	}
 
-	// Each old edge will produce (d-1) new midpoints and d new edges
-	for (auto& pair : edges)
+	// Interior points, interior edges and children of the old faces
+	vector<DirectedEdgeTriplet> triangles(F);
+#pragma omp parallel for if (F0 >= 256) num_threads(ThreadsMaximum)
+	for (int f = 0; f < (int)F0; ++f)
 	{
-		const Point& A = _V[pair.first];
-		const Point& B = _V[pair.second];
+		const DirectedEdge parent[3] = {
+			std::get<0>(_F[f]), std::get<1>(_F[f]), std::get<2>(_F[f])
+		};
+		// The corners are the first vertices of the directed edges
+		size_t corner[3];
+		for (size_t i = 0; i < 3; ++i)
+		{
+			const auto& edge = _E[parent[i].first];
+			corner[i] = parent[i].second ? edge.first : edge.second;
+		}
 
-		// Add first edge
-		size_t midpointIndex = _V.size();
-		_E.emplace_back(std::make_pair(pair.first, midpointIndex));
+		// Point t of an old edge, counted from the first vertex of the face
+		// edge, in the direction of the face
+		auto along = [&](size_t i, size_t t) {
+			if (t == 0) return corner[i];
+			if (t == d) return corner[(i + 1) % 3];
+			size_t s = parent[i].second ? t : d - t;
+			return V0 + (d - 1) * parent[i].first + s - 1;
+		};
+		// Lattice point (b, c), with a = d - b - c
+		auto vertex = [&](size_t b, size_t c) {
+			size_t a = d - b - c;
+			if (c == 0) return along(0, b);
+			if (a == 0) return along(1, c);
+			if (b == 0) return along(2, d - c);
+			return V0 + (d - 1) * E0 + VI * f + interiorPoint(b, c);
+		};
+		// Segment t of an old edge in the direction of the face
+		auto segment = [&](size_t i, size_t t) {
+			return parent[i].second
+				? DirectedEdge(d * parent[i].first + t, true)
+				: DirectedEdge(d * parent[i].first + d - 1 - t, false);
+		};
+		// Lattice edges from (b, c) towards B, towards C, and from (b+1, c)
+		// towards (b, c+1)
+		size_t inner = d * E0 + EI * f;
+		auto towardsB = [&](size_t b, size_t c) {
+			return c == 0 ? segment(0, b) : DirectedEdge(inner + edgeAB(b, c), true);
+		};
+		auto towardsC = [&](size_t b, size_t c) {
+			if (b == 0)
+			{
+				DirectedEdge s = segment(2, d - 1 - c);
+				return DirectedEdge(s.first, !s.second);
+			}
+			return DirectedEdge(inner + edgeAC(b, c), true);
+		};
+		auto acrossBC = [&](size_t b, size_t c) {
+			return b + c + 1 == d ? segment(1, c) : DirectedEdge(inner + edgeBC(b, c), true);
+		};
+		auto reverse = [](DirectedEdge e) { return DirectedEdge(e.first, !e.second); };
+
+		// Interior points
+		const Point& A = _V[corner[0]];
+		const Point& B = _V[corner[1]];
+		const Point& C = _V[corner[2]];
+		for (size_t c = 1; c + 1 < d; ++c)
+		{
+			for (size_t b = 1; b + c < d; ++b)
+			{
+				FL3 x = A.image() * (double)(d - b - c) + B.image() * (double)b
+					+ C.image() * (double)c;
+				_V[vertex(b, c)] = Point(Image(normalize(x)));
+			}
+		}
 
-		// Construct midpoints and their in-between edges
-		Cartosphere::Arc arc(A, B);
-		for (size_t d = 1; d < division; ++d, ++midpointIndex)
+		// Interior edges
+		for (size_t c = 0; c < d; ++c)
 		{
-			double alpha = 1.0 * d / division;
-			_V.push_back(arc.local(alpha));
-			_E.push_back(std::make_pair(midpointIndex, midpointIndex + 1));
+			for (size_t b = 0; b + c < d; ++b)
+			{
+				if (c > 0)
+				{
+					edges[inner + edgeAB(b, c)] = std::make_pair(vertex(b, c), vertex(b + 1, c));
+				}
+				if (b > 0)
+				{
+					edges[inner + edgeAC(b, c)] = std::make_pair(vertex(b, c), vertex(b, c + 1));
+				}
+				if (b + c + 1 < d)
+				{
+					edges[inner + edgeBC(b, c)] = std::make_pair(vertex(b + 1, c), vertex(b, c + 1));
+				}
+			}
 		}
 
-		// Add last edge
-		_E.emplace_back(std::make_pair(midpointIndex - 1, pair.second));
+		// Children: the upward (b, c), (b+1, c), (b, c+1), then the downward
+		// (b+1, c), (b+1, c+1), (b, c+1), both in the orientation of the face
+		size_t child = d * d * f;
+		for (size_t c = 0; c < d; ++c)
+		{
+			for (size_t b = 0; b + c < d; ++b)
+			{
+				triangles[child++] = DirectedEdgeTriplet(towardsB(b, c),
+					acrossBC(b, c), reverse(towardsC(b, c)));
+			}
+		}
+		for (size_t c = 0; c + 1 < d; ++c)
+		{
+			for (size_t b = 0; b + c + 1 < d; ++b)
+			{
+				triangles[child++] = DirectedEdgeTriplet(towardsC(b + 1, c),
+					reverse(towardsB(b, c + 1)), reverse(acrossBC(b, c)));
+			}
+		}
+	}
+	_E.swap(edges);
+	_F.swap(triangles);
+	vector<UndirectedEdge>().swap(edges);
+	vector<DirectedEdgeTriplet>().swap(triangles);
+
+	// Refresh the redundant states, and split the leaves of the tree
+	_FA.clear();
+	_FP.clear();
+	_VE.clear();
+	_VF.clear();
+	_FV.clear();
+	_FF.clear();
+	_FC.clear();
+	_slots.clear();
+	if (!_populate_faces())
+	{
+		return;
 	}
+	_populate_geometry();
+	_populate_incidence();
+	_tree.refine(*this, d * d);
+}
 
-	// TODO: construct vertices and edges in the interior of the triangle
+vector<double>
+Cartosphere::TriangularMesh::estimate() const
+{
+	// Residual estimator without the interior residual: each edge of a face
+	// contributes h^2 [du/dn]^2 / 2, the jump taken at the edge midpoint
+	vector<double> eta(_FV.size(), 0);
+	if (_a.size() != _V.size())
+	{
+		return eta;
+	}
+#pragma omp parallel for if (_FV.size() >= 1024) num_threads(ThreadsMaximum)
+	for (int k = 0; k < (int)_FV.size(); ++k)
+	{
+		Face f = face(k);
+		double sum = 0;
+		for (size_t j = 0; j < 3; ++j)
+		{
+			size_t g = _FF[k][j];
+			if (g == NoIndex)
+			{
+				continue;
+			}
+			const FL3& A = _V[_FV[k][(j + 1) % 3]].image();
+			const FL3& B = _V[_FV[k][(j + 2) % 3]].image();
+			FL3 x = normalize(A + B);
+			Face h = face(g);
+			FL3 jump;
+			for (size_t i = 0; i < 3; ++i)
+			{
+				jump += _a[_FV[k][i]] * f.basis(i).gradient(x);
+				jump += -_a[_FV[g][i]] * h.basis(i).gradient(x);
+			}
+			sum += 0.5 * (A - B).norm2sq() * pow(dot(jump, _FP[3 * k + j]), 2);
+		}
+		eta[k] = sqrt(sum);
+	}
+	return eta;
+}
 
-	// TODO: construct faces
+void
+Cartosphere::TriangularMesh::bisect(const vector<size_t>& faces)
+{
+	vector<char> refine(_FV.size(), 0);
+	for (size_t k : faces)
+	{
+		refine[k] = 1;
+	}
+	_adapt(refine, vector<char>(_FV.size(), 0));
+}
 
-	// Refresh the list of simplices
-	_populate();
+void
+Cartosphere::TriangularMesh::coarsen(const vector<size_t>& faces)
+{
+	vector<char> coarsen(_FV.size(), 0);
+	for (size_t k : faces)
+	{
+		coarsen[k] = 1;
+	}
+	_adapt(vector<char>(_FV.size(), 0), coarsen);
 }
 
 void
-Cartosphere::TriangularMesh::fill(SparseMatrixRowMajor& A, Triangle::Integrator intr) const
+Cartosphere::TriangularMesh::adapt(double refine, double coarsen)
 {
-	auto stat = statistics();
+	// Mark the largest indicators making up the fraction `refine` of the
+	// total, and the smallest making up no more than the fraction `coarsen`
+	vector<double> eta = estimate();
+	vector<size_t> order(eta.size());
+	double total = 0;
+	for (size_t k = 0; k < eta.size(); ++k)
+	{
+		order[k] = k;
+		total += eta[k] * eta[k];
+	}
+	std::sort(order.begin(), order.end(), [&eta](size_t a, size_t b) {
+		return eta[a] > eta[b];
+	});
 
-	// Construct a square matrix and one row for each vertex
-	int N = (int)stat.V;
-	A.resize(N, N);
+	vector<char> refined(eta.size(), 0), coarsened(eta.size(), 0);
+	double sum = 0;
+	size_t marked = 0;
+	for (; marked < order.size() && sum < refine * total; ++marked)
+	{
+		sum += eta[order[marked]] * eta[order[marked]];
+		refined[order[marked]] = 1;
+	}
+	sum = 0;
+	for (size_t i = order.size(); i > marked; --i)
+	{
+		sum += eta[order[i - 1]] * eta[order[i - 1]];
+		if (sum > coarsen * total)
+		{
+			break;
+		}
+		coarsened[order[i - 1]] = 1;
+	}
+	_adapt(refined, coarsened);
+}
 
-	// Preparation!
-	// 1. Need to get the poles (E-loop)
-	vector<Cartosphere::Point> poles;
-	poles.reserve(stat.E);
+void
+Cartosphere::TriangularMesh::_adapt(const vector<char>& refine,
+	const vector<char>& coarsen)
+{
+	if (!_bParseSuccess)
+	{
+		return;
+	}
+	size_t V0 = _V.size(), E0 = _E.size(), F0 = _FV.size();
+
+	// Newest-vertex bisection splits a face (t0, t1, t2) at the midpoint m
+	// of the edge t1-t2 into (m, t0, t1) and (m, t2, t0), so that the first
+	// vertex of every face is the newest and the edge opposite is the next
+	// to bisect. On the first adaptation, the faces are labelled by their
+	// longest edges, ties broken by vertex indices.
+	vector<IndexTriplet> faces(_FV);
+	vector<unsigned char> rotation(F0, 0);
+	if (_VB.size() != V0)
+	{
+		_VB.assign(V0, { NoIndex, NoIndex });
+		for (size_t k = 0; k < F0; ++k)
+		{
+			const IndexTriplet& v = _FV[k];
+			auto key = [this, &v](size_t j) {
+				Index a = v[(j + 1) % 3], b = v[(j + 2) % 3];
+				double length = (_V[a].image() - _V[b].image()).norm2sq();
+				return std::make_tuple(length, std::min(a, b), std::max(a, b));
+			};
+			size_t r = 0;
+			for (size_t j = 1; j < 3; ++j)
+			{
+				if (key(j) > key(r))
+				{
+					r = j;
+				}
+			}
+			rotation[k] = (unsigned char)r;
+			faces[k] = { v[r], v[(r + 1) % 3], v[(r + 2) % 3] };
+		}
+	}
+	// The edge opposite vertex j of a labelled face, and the face across
+	auto edge = [this, &rotation](size_t k, size_t j) {
+		// Directed edge i starts at vertex i and is opposite vertex i + 2
+		size_t i = (j + rotation[k] + 1) % 3;
+		const auto& t = _F[k];
+		return i == 0 ? std::get<0>(t).first
+			: i == 1 ? std::get<1>(t).first : std::get<2>(t).first;
+	};
+	auto across = [this, &rotation](size_t k, size_t j) {
+		return _FF[k][(j + rotation[k]) % 3];
+	};
+
+	// Mark the edges to bisect: a face with any marked edge must have its
+	// own refinement edge marked for the mesh to stay conforming
+	vector<char> marked(E0, 0);
+	vector<size_t> stack;
+	for (size_t k = 0; k < F0; ++k)
+	{
+		if (refine[k])
+		{
+			stack.push_back(k);
+		}
+	}
+	while (!stack.empty())
+	{
+		size_t k = stack.back();
+		stack.pop_back();
+		size_t e = edge(k, 0);
+		if (marked[e])
+		{
+			continue;
+		}
+		marked[e] = 1;
+		size_t g = across(k, 0);
+		if (g != NoIndex)
+		{
+			stack.push_back(g);
+		}
+	}
 
-	// E-loop
-	for (const auto& e : _E)
+	// A bisection (t0, t1, t2) -> (m, t0, t1), (m, t2, t0) is undone if m
+	// is the newest vertex of all its faces, none of which is split and all
+	// of which are marked; the first face of each pair is the one whose
+	// second vertex t0 is not an endpoint of the bisected edge
+	auto sibling = [this, &faces](size_t m, size_t x) {
+		for (Index y : _VF[m])
+		{
+			if (faces[y][2] == faces[x][1])
+			{
+				return (size_t)y;
+			}
+		}
+		return (size_t)NoIndex;
+	};
+	auto bisected = [this](size_t m, Index v) {
+		return _VB[m][0] == v || _VB[m][1] == v;
+	};
+	vector<char> removed(V0, 0);
+#pragma omp parallel for if (V0 >= 1024) num_threads(ThreadsMaximum)
+	for (int m = 0; m < (int)V0; ++m)
 	{
-		// Construct directional arc and extract its pole
-		const Point& a = _V[e.first];
-		const Point& b = _V[e.second];
-		Arc arc(a, b);
-		poles.push_back(arc.pole());
+		auto list = _VF[m];
+		if (_VB[m][0] == NoIndex || (list.size() != 2 && list.size() != 4))
+		{
+			continue;
+		}
+		bool removable = true;
+		size_t pairs = 0;
+		for (Index x : list)
+		{
+			removable = removable && faces[x][0] == (Index)m && coarsen[x]
+				&& !marked[edge(x, 0)];
+			if (removable && !bisected(m, faces[x][1]))
+			{
+				size_t y = sibling(m, x);
+				removable = y != NoIndex && bisected(m, faces[x][2])
+					&& bisected(m, faces[y][1]);
+				++pairs;
+			}
+		}
+		removed[m] = removable && 2 * pairs == list.size();
 	}
 
-	// 2. Need to get the magnitude of all gradient vectors (T-loop)
-	vector<double> magnitudes;
-	magnitudes.reserve(3 * stat.F);
-	Point pole, vertex;
+	// New vertices are the midpoints of the marked edges, with nodal values
+	// interpolated linearly
+	bool values = _a.size() == V0;
+	vector<Index> midpoints(E0, NoIndex);
+	size_t V = V0;
+	for (size_t e = 0; e < E0; ++e)
+	{
+		if (marked[e])
+		{
+			midpoints[e] = (Index)V++;
+		}
+	}
+	_V.resize(V);
+	_VB.resize(V);
+	if (values)
+	{
+		_a.resize(V);
+	}
+#pragma omp parallel for if (E0 >= 1024) num_threads(ThreadsMaximum)
+	for (int e = 0; e < (int)E0; ++e)
+	{
+		if (marked[e])
+		{
+			size_t m = midpoints[e], a = _E[e].first, b = _E[e].second;
+			_V[m] = midpoint(_V[a], _V[b]);
+			_VB[m] = { (Index)a, (Index)b };
+			if (values)
+			{
+				_a[m] = (_a[a] + _a[b]) / 2;
+			}
+		}
+	}
 
-	// F-loop
-	for (size_t k = 0; k < stat.F; ++k)
+	// Split faces: the first child takes the place of the face, and the
+	// others are appended. A child is split again if its refinement edge,
+	// an edge of the face, is marked.
+	vector<IndexTriplet> output(faces);
+	vector<char> deleted(F0, 0);
+	for (size_t k = 0; k < F0; ++k)
 	{
-		// Vertex A: PI/2 minus distance from A to the pole of BC
-		vertex = _vt[k].A;
+		if (!marked[edge(k, 0)])
 		{
-			const auto& edgeInfo = std::get<1>(_F[k]);
-			const auto& edge = _E[edgeInfo.first];
-			pole = poles[edgeInfo.first];
-			if (!edgeInfo.second)
-				pole.flip();
+			continue;
 		}
-		magnitudes.push_back(M_PI_2 - distance(pole, vertex));
-		// Vertex B: PI/2 minus distance from B to the pole of CA
-		vertex = _vt[k].B;
+		Index t0 = faces[k][0], t1 = faces[k][1], t2 = faces[k][2];
+		Index m = midpoints[edge(k, 0)];
+		IndexTriplet children[4];
+		size_t count = 0;
+		if (marked[edge(k, 2)])
 		{
-			const auto& edgeInfo = std::get<2>(_F[k]);
-			const auto& edge = _E[edgeInfo.first];
-			pole = poles[edgeInfo.first];
-			if (!edgeInfo.second)
-				pole.flip();
+			Index p = midpoints[edge(k, 2)];
+			children[count++] = { p, m, t0 };
+			children[count++] = { p, t1, m };
 		}
-		magnitudes.push_back(M_PI_2 - distance(pole, vertex));
-		// Vertex C: PI/2 minus distance from C to the pole of AB
-		vertex = _vt[k].C;
+		else
 		{
-			const auto& edgeInfo = std::get<0>(_F[k]);
-			const auto& edge = _E[edgeInfo.first];
-			pole = poles[edgeInfo.first];
-			if (!edgeInfo.second)
-				pole.flip();
+			children[count++] = { m, t0, t1 };
 		}
-		magnitudes.push_back(M_PI_2 - distance(pole, vertex));
+		if (marked[edge(k, 1)])
+		{
+			Index q = midpoints[edge(k, 1)];
+			children[count++] = { q, m, t2 };
+			children[count++] = { q, t0, m };
+		}
+		else
+		{
+			children[count++] = { m, t2, t0 };
+		}
+		output[k] = children[0];
+		output.insert(output.end(), children + 1, children + count);
 	}
 
-	for (size_t k = 0; k < 3 * stat.F; ++k)
+	// Merge the pairs of faces around the removed vertices
+	for (size_t m = 0; m < V0; ++m)
 	{
-		magnitudes[k] = 1 / magnitudes[k];
+		if (!removed[m])
+		{
+			continue;
+		}
+		for (Index x : _VF[m])
+		{
+			if (!bisected(m, faces[x][1]))
+			{
+				size_t y = sibling(m, x);
+				output[x] = { faces[x][1], faces[x][2], faces[y][1] };
+				deleted[y] = 1;
+			}
+		}
 	}
 
-	// 3. Need to numerically construct the local stiffness matrices
-	// The inner product of gradient vectors has been converted to a spherical
-	// trigonometry problem, but we need to use quadratures on spherical triangles.
-	auto L = new double [stat.F][3][3]();
+	// Compact the vertices and the faces
+	vector<Index> renumber(V);
+	size_t kept = 0;
+	for (size_t v = 0; v < V; ++v)
+	{
+		renumber[v] = (Index)kept;
+		if (v >= V0 || !removed[v])
+		{
+			_V[kept] = _V[v];
+			_VB[kept] = _VB[v];
+			for (Index& u : _VB[kept])
+			{
+				u = u == NoIndex ? NoIndex : renumber[u];
+			}
+			if (values)
+			{
+				_a[kept] = _a[v];
+			}
+			++kept;
+		}
+	}
+	_V.resize(kept);
+	_VB.resize(kept);
+	if (values)
+	{
+		_a.resize(kept);
+	}
+	size_t F = 0;
+	for (size_t k = 0; k < output.size(); ++k)
+	{
+		if (k >= F0 || !deleted[k])
+		{
+			for (size_t j = 0; j < 3; ++j)
+			{
+				output[F][j] = renumber[output[k][j]];
+			}
+			++F;
+		}
+	}
+	output.resize(F);
 
-	// T-loop.
-	for (size_t k = 0; k < stat.F; ++k)
-	{
-		auto& local = L[k];
-		const auto& triangle = _vt[k];
-
-		// Compute the diagonal entries
-		// double area = triangle.area();
-		// local[0][0] = area * pow(magnitudes[3 * k + 0], 2);
-		// local[1][1] = area * pow(magnitudes[3 * k + 1], 2);
-		// local[2][2] = area * pow(magnitudes[3 * k + 2], 2);
-		// Code above is bad because the exact solutions are inconsistent with
-		// the numerical integration used on the off-diagonal entries
-
-		// Extract poles of edges for use of the equivalent geometric problem
-		auto poleBC = poles[std::get<1>(_F[k]).first];
-		if (!std::get<1>(_F[k]).second)
-			poleBC.flip();
-		auto poleCA = poles[std::get<2>(_F[k]).first];
-		if (!std::get<2>(_F[k]).second)
-			poleCA.flip();
-		auto poleAB = poles[std::get<0>(_F[k]).first];
-		if (!std::get<0>(_F[k]).second)
-			poleAB.flip();
-		
-		// Numerically integrate the inner product of gradient of functions
-		auto unit = [](const Point& x)->double { return 1; };
-		local[0][0] = 
-			triangle.integrate(unit, intr) * magnitudes[3 * k + 0] * magnitudes[3 * k + 0];
+	// Rebuild the mesh; faces no longer have four children each
+	retainHierarchy(false);
+	vector<std::array<Index, 2>> history;
+	history.swap(_VB);
+	_connect(output);
+	_populate();
+	_VB.swap(history);
+	if (values)
+	{
+		set(vector<double>(_a));
+	}
+}
 
-		local[1][1] =
-			triangle.integrate(unit, intr) * magnitudes[3 * k + 1] * magnitudes[3 * k + 1];
+void
+Cartosphere::TriangularMesh::_connect(const vector<IndexTriplet>& faces)
+{
+	// Number the edges by sorting the sides of all faces by their endpoints
+	vector<std::tuple<Index, Index, size_t>> sides(3 * faces.size());
+	for (size_t k = 0; k < faces.size(); ++k)
+	{
+		for (size_t j = 0; j < 3; ++j)
+		{
+			Index a = faces[k][j], b = faces[k][(j + 1) % 3];
+			sides[3 * k + j] = std::make_tuple(std::min(a, b), std::max(a, b), 3 * k + j);
+		}
+	}
+	std::sort(sides.begin(), sides.end());
 
-		local[2][2] =
-			triangle.integrate(unit, intr) * magnitudes[3 * k + 2] * magnitudes[3 * k + 2];
+	vector<DirectedEdge> directed(sides.size());
+	_E.clear();
+	for (size_t i = 0; i < sides.size(); ++i)
+	{
+		Index a = std::get<0>(sides[i]), b = std::get<1>(sides[i]);
+		if (_E.empty() || _E.back() != UndirectedEdge(a, b))
+		{
+			_E.emplace_back(a, b);
+		}
+		size_t side = std::get<2>(sides[i]);
+		directed[side] = DirectedEdge(_E.size() - 1, faces[side / 3][side % 3] == a);
+	}
+	_F.resize(faces.size());
+	for (size_t k = 0; k < faces.size(); ++k)
+	{
+		_F[k] = DirectedEdgeTriplet(directed[3 * k], directed[3 * k + 1], directed[3 * k + 2]);
+	}
+}
 
-		// Off-diagonal entries
-		auto iAB = [&poleBC, &poleCA](const Point &x)->double {
-			return cos(angle(poleCA.image(), x.image(), poleBC.image()));
-		};
-		local[1][0] = local[0][1] =
-			triangle.integrate(iAB, intr) * magnitudes[3 * k + 0] * magnitudes[3 * k + 1];
+// Position of a point of the cube [-1, 1]^3 along a Hilbert curve of 2^63
+// cells, by Skilling's transposition of the coordinates
+static std::uint64_t
+hilbertKey(const FL3& x)
+{
+	const int bits = 21;
+	const std::uint32_t top = 1u << (bits - 1);
+	std::uint32_t X[3] = {
+		(std::uint32_t)std::min((x.x + 1) / 2 * (1u << bits), (1u << bits) - 1.0),
+		(std::uint32_t)std::min((x.y + 1) / 2 * (1u << bits), (1u << bits) - 1.0),
+		(std::uint32_t)std::min((x.z + 1) / 2 * (1u << bits), (1u << bits) - 1.0)
+	};
+	// Inverse undo
+	for (std::uint32_t Q = top; Q > 1; Q >>= 1)
+	{
+		std::uint32_t P = Q - 1;
+		for (int i = 0; i < 3; ++i)
+		{
+			if (X[i] & Q)
+			{
+				X[0] ^= P;
+			}
+			else
+			{
+				std::uint32_t t = (X[0] ^ X[i]) & P;
+				X[0] ^= t;
+				X[i] ^= t;
+			}
+		}
+	}
+	// Gray encode
+	X[1] ^= X[0];
+	X[2] ^= X[1];
+	std::uint32_t t = 0;
+	for (std::uint32_t Q = top; Q > 1; Q >>= 1)
+	{
+		if (X[2] & Q)
+		{
+			t ^= Q - 1;
+		}
+	}
+	// Interleave the transposed bits
+	std::uint64_t key = 0;
+	for (int b = bits - 1; b >= 0; --b)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			key = (key << 1) | (((X[i] ^ t) >> b) & 1);
+		}
+	}
+	return key;
+}
 
-		auto iCA = [&poleBC, &poleAB](const Point& x)->double {
-			return cos(angle(poleBC.image(), x.image(), poleAB.image()));
-		};
-		local[2][0] = local[0][2] =
-			triangle.integrate(iCA, intr) * magnitudes[3 * k + 0] * magnitudes[3 * k + 2];
+vector<size_t>
+Cartosphere::TriangularMesh::reorder(Ordering ordering)
+{
+	size_t V = _V.size(), E = _E.size(), F = _F.size();
+	vector<size_t> order(V);
+	for (size_t i = 0; i < V; ++i)
+	{
+		order[i] = i;
+	}
+	if (!_bParseSuccess)
+	{
+		return order;
+	}
 
-		auto iBC = [&poleAB, &poleCA](const Point& x)->double {
-			return cos(angle(poleAB.image(), x.image(), poleCA.image()));
+	// The old index of each new vertex
+	if (ordering == Ordering::Hilbert)
+	{
+		vector<std::pair<std::uint64_t, size_t>> keys(V);
+#pragma omp parallel for if (V >= 1024) num_threads(ThreadsMaximum)
+		for (int i = 0; i < (int)V; ++i)
+		{
+			keys[i] = std::make_pair(hilbertKey(_V[i].image()), (size_t)i);
+		}
+		std::sort(keys.begin(), keys.end());
+		for (size_t i = 0; i < V; ++i)
+		{
+			order[i] = keys[i].second;
+		}
+	}
+	else
+	{
+		// Breadth-first from a vertex of least degree, visiting neighbours
+		// by increasing degree, then reversed; the start is moved to the last
+		// level of its own search once, towards the periphery
+		auto degree = [this](size_t i) { return _VE[i].size(); };
+		auto neighbour = [this](size_t i, size_t e) {
+			return _E[e].first == i ? _E[e].second : _E[e].first;
 		};
-		local[2][1] = local[1][2] =
-			triangle.integrate(iBC, intr) * magnitudes[3 * k + 1] * magnitudes[3 * k + 2];
+		vector<char> visited(V, 0);
+		vector<size_t> level;
+		auto search = [&](size_t start, size_t offset) {
+			size_t head = offset, tail = offset;
+			order[tail++] = start;
+			visited[start] = 1;
+			while (head < tail)
+			{
+				size_t i = order[head++];
+				size_t first = tail;
+				for (Index e : _VE[i])
+				{
+					size_t j = neighbour(i, e);
+					if (!visited[j])
+					{
+						visited[j] = 1;
+						order[tail++] = j;
+					}
+				}
+				std::sort(order.begin() + first, order.begin() + tail,
+					[&degree](size_t a, size_t b) {
+						return degree(a) < degree(b) || (degree(a) == degree(b) && a < b);
+					});
+			}
+			return tail;
+		};
+		vector<size_t> byDegree(order);
+		std::stable_sort(byDegree.begin(), byDegree.end(), [&degree](size_t a, size_t b) {
+			return degree(a) < degree(b);
+		});
+		size_t done = 0;
+		for (size_t start : byDegree)
+		{
+			if (visited[start])
+			{
+				continue;
+			}
+			// Restart from the last vertex reached, then keep the order
+			size_t tail = search(start, done);
+			size_t last = order[tail - 1];
+			for (size_t k = done; k < tail; ++k)
+			{
+				visited[order[k]] = 0;
+			}
+			done = search(last, done);
+		}
+		std::reverse(order.begin(), order.end());
+	}
+	vector<Index> inverse(V);
+	for (size_t i = 0; i < V; ++i)
+	{
+		inverse[order[i]] = (Index)i;
+	}
+
+	// Vertices and the states at vertices
+	auto permute = [&order](auto& values) {
+		if (values.size() == order.size())
+		{
+			std::remove_reference_t<decltype(values)> permuted(values.size());
+			for (size_t i = 0; i < order.size(); ++i)
+			{
+				permuted[i] = values[order[i]];
+			}
+			values.swap(permuted);
+		}
+	};
+	permute(_V);
+	permute(_a);
+	permute(_grad);
+	permute(_VB);
+	for (auto& bisected : _VB)
+	{
+		for (Index& v : bisected)
+		{
+			v = v == NoIndex ? NoIndex : inverse[v];
+		}
+	}
+
+	// Edges, keeping their directions, by their new endpoints: bucketed by
+	// the smaller, then sorted by the larger within each bucket
+	vector<Index> lows(E), indices(E);
+	for (size_t e = 0; e < E; ++e)
+	{
+		_E[e] = std::make_pair(inverse[_E[e].first], inverse[_E[e].second]);
+		lows[e] = (Index)std::min(_E[e].first, _E[e].second);
+		indices[e] = (Index)e;
+	}
+	Adjacency buckets;
+	buckets.build(V, lows, indices);
+	auto high = [this](Index e) { return std::max(_E[e].first, _E[e].second); };
+	vector<size_t> edgeInverse(E);
+	vector<UndirectedEdge> edges(E);
+	for (size_t i = 0; i < V; ++i)
+	{
+		Index* first = buckets.items.data() + buckets.offsets[i];
+		Index* last = buckets.items.data() + buckets.offsets[i + 1];
+		std::sort(first, last, [&high](Index a, Index b) { return high(a) < high(b); });
+	}
+	for (size_t e = 0; e < E; ++e)
+	{
+		edgeInverse[buckets.items[e]] = e;
+		edges[e] = _E[buckets.items[e]];
+	}
+	_E.swap(edges);
+
+	// Faces by their new vertices, smallest first, in the same way
+	vector<IndexTriplet> keys(F);
+	lows.resize(F);
+	indices.resize(F);
+	for (size_t k = 0; k < F; ++k)
+	{
+		keys[k] = { inverse[_FV[k][0]], inverse[_FV[k][1]], inverse[_FV[k][2]] };
+		std::sort(keys[k].begin(), keys[k].end());
+		lows[k] = keys[k][0];
+		indices[k] = (Index)k;
+	}
+	buckets.build(V, lows, indices);
+	for (size_t i = 0; i < V; ++i)
+	{
+		Index* first = buckets.items.data() + buckets.offsets[i];
+		Index* last = buckets.items.data() + buckets.offsets[i + 1];
+		std::sort(first, last, [&keys](Index a, Index b) { return keys[a] < keys[b]; });
 	}
-
-	// 4. Calculate the adjacency of vertices from the list of undirected edges
-	// by populating the zero-valued entries of the global stiffness matrix
-	vector<size_t> rows, cols;
-	
-	// V-loop: diagonal entries
-	for (size_t i = 0; i < stat.V; ++i)
+	const vector<Index>& faceOrder = buckets.items;
+	vector<size_t> faceInverse(F);
+	vector<DirectedEdgeTriplet> triangles(F);
+	vector<double> areas(F);
+	vector<FL3> poles(3 * F);
+	auto remap = [&edgeInverse](DirectedEdge e) {
+		return DirectedEdge(edgeInverse[e.first], e.second);
+	};
+	for (size_t k = 0; k < F; ++k)
 	{
-		rows.push_back(i);
-		cols.push_back(i);
+		size_t old = faceOrder[k];
+		faceInverse[old] = k;
+		const auto& t = _F[old];
+		triangles[k] = DirectedEdgeTriplet(remap(std::get<0>(t)),
+			remap(std::get<1>(t)), remap(std::get<2>(t)));
+		// The vertices of each face keep their rotation, so does its geometry
+		areas[k] = _FA[old];
+		for (size_t j = 0; j < 3; ++j)
+		{
+			poles[3 * k + j] = _FP[3 * old + j];
+		}
 	}
-	
-	// E-loop: undirected edges gives two directed edges
-	for (size_t i = 0; i < stat.E; ++i)
+	_F.swap(triangles);
+	_FA.swap(areas);
+	_FP.swap(poles);
+
+	// Faces no longer have their children at 4k to 4k + 3
+	retainHierarchy(false);
+
+	// The tree keeps its caps, only its entries are renumbered
+	_populate_faces();
+	_populate_incidence();
+	for (size_t& entry : _tree._entries)
 	{
-		rows.push_back(_E[i].first);
-		cols.push_back(_E[i].second);
-		rows.push_back(_E[i].second);
-		cols.push_back(_E[i].first);
+		entry = faceInverse[entry];
 	}
+	return order;
+}
+
+void
+Cartosphere::TriangularMesh::fill(SparseMatrixRowMajor& A, Triangle::Integrator intr) const
+{
+	auto stat = statistics();
+
+	// 1. Numerically construct the local stiffness matrices
+	auto L = new double [stat.F][3][3]();
 
-	// 5. Assemble the global stiffness matrix from the local stiffness matrix
-	vector<SparseMatrixEntry> entries;
-	for (size_t k = 0; k < rows.size(); ++k)
+	// T-loop.
+#pragma omp parallel for if (stat.F >= 1024) num_threads(ThreadsMaximum)
+	for (int k = 0; k < (int)stat.F; ++k)
 	{
-		double value = 0;
-		
-		// Calculate the common support
-		const auto& support1 = _VF[rows[k]];
-		const auto& support2 = _VF[cols[k]];
-		vector<size_t> support;
-		std::set_intersection(
-			support1.cbegin(), support1.cend(),
-			support2.cbegin(), support2.cend(),
-			std::back_inserter(support)
-		);
-
-		// For each face in the support find the appropriate local stiffness
-		for (auto index : support)
-		{
-			const auto& fv = _FV[index];
-			size_t i = std::find(fv.cbegin(), fv.cend(), rows[k]) - fv.cbegin();
-			size_t j = std::find(fv.cbegin(), fv.cend(), cols[k]) - fv.cbegin();
-			value += L[index][i][j];
-		}
-		
-		SparseMatrixEntry e;
-		double v = e.value();
-		// Unfortunately, the value() field is private.
-		entries.emplace_back((int)rows[k], (int)cols[k], value);
+		_local_stiffness(k, intr, L[k]);
 	}
 
-	delete[] L;
+	// 2. Scatter the local stiffness matrices into the global one
+	_assemble(A, L);
 
-	A.setFromTriplets(entries.begin(), entries.end());
+	delete[] L;
 }
 
 void
@@ -1880,87 +3687,101 @@ Cartosphere::TriangularMesh::fill(SparseMatrixRowMajor& A, SparseMatrixRowMajor&
 	// 2. Build the inner matrix
 	auto stat = statistics();
 
-	// Construct a square matrix and one row for each vertex
-	int N = (int)stat.V;
-	M.resize(N, N);
-
-	// 3. Need to numerically construct the local stiffness matrices
+	// 3. Need to numerically construct the local mass matrices
 	auto L = new double[stat.F][3][3]();
 
 	// T-loop.
-	for (size_t k = 0; k < stat.F; ++k)
+#pragma omp parallel for if (stat.F >= 1024) num_threads(ThreadsMaximum)
+	for (int k = 0; k < (int)stat.F; ++k)
 	{
-		auto& local = L[k];
-		const auto& triangle = _vt[k];
+		_local_mass(k, intr, L[k]);
+	}
+
+	// 4. Scatter the local matrices into the global one
+	_assemble(M, L);
+
+	delete[] L;
+}
+
+void
+Cartosphere::TriangularMesh::local(size_t triangleIndex, double (&A)[3][3],
+	double (&M)[3][3], Triangle::Integrator intr) const
+{
+	_local_stiffness(triangleIndex, intr, A);
+	_local_mass(triangleIndex, intr, M);
+}
 
+void
+Cartosphere::TriangularMesh::_local_stiffness(size_t k, Triangle::Integrator intr,
+	double (&local)[3][3]) const
+{
+	// The gradient of an element points towards the pole of the opposite edge
+	// with magnitude 1/height, so the inner product of two gradients is the
+	// cosine of the angle pole-x-pole, divided by both heights
+	std::fill(&local[0][0], &local[0][0] + 9, 0.0);
+	Face triangle = face(k);
+	Element e[3] = { triangle.basis(0), triangle.basis(1), triangle.basis(2) };
+	double m[3] = { 1 / e[0].height(), 1 / e[1].height(), 1 / e[2].height() };
+
+	// One pass per quadrature node for all entries, where the diagonal
+	// integrates the constant function with the same rule
+	triangle.quadrature([&e, &m, &local](const FL3& x, double w) {
+		double h[3], s[3];
 		for (int i = 0; i < 3; ++i)
 		{
-			for (int j = 0; j < 3; ++j)
+			h[i] = dot(e[i].pole(), x);
+			s[i] = std::sqrt(std::max(0.0, 1 - h[i] * h[i]));
+			local[i][i] += w * m[i] * m[i];
+		}
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < i; ++j)
 			{
-				Function f = triangle.element(i);
-				Function g = triangle.element(j);
-				Function inner = [&f, &g](const Point& p) -> double {
-					return f(p) * g(p);
-				};
-				L[k][i][j] = triangle.integrate(inner, intr);
+				// A pole at x spans a right angle by convention
+				double c = 0;
+				if (s[i] > DoubleEpsilon && s[j] > DoubleEpsilon)
+				{
+					c = (dot(e[i].pole(), e[j].pole()) - h[i] * h[j]) / (s[i] * s[j]);
+				}
+				local[i][j] += w * c * m[i] * m[j];
 			}
 		}
-	}
-
-	// 4. Calculate the adjacency of vertices from the list of undirected edges
-	// by populating the zero-valued entries of the global stiffness matrix
-	vector<size_t> rows, cols;
-
-	// V-loop: diagonal entries
-	for (size_t i = 0; i < stat.V; ++i)
+	}, intr);
+	for (int i = 0; i < 3; ++i)
 	{
-		rows.push_back(i);
-		cols.push_back(i);
+		for (int j = 0; j < i; ++j)
+		{
+			local[j][i] = local[i][j];
+		}
 	}
+}
 
-	// E-loop: undirected edges gives two directed edges
-	for (size_t i = 0; i < stat.E; ++i)
-	{
-		rows.push_back(_E[i].first);
-		cols.push_back(_E[i].second);
-		rows.push_back(_E[i].second);
-		cols.push_back(_E[i].first);
-	}
+void
+Cartosphere::TriangularMesh::_local_mass(size_t k, Triangle::Integrator intr,
+	double (&local)[3][3]) const
+{
+	std::fill(&local[0][0], &local[0][0] + 9, 0.0);
+	Face triangle = face(k);
+	Element e[3] = { triangle.basis(0), triangle.basis(1), triangle.basis(2) };
 
-	// 5. Assemble the global stiffness matrix from the local stiffness matrix
-	vector<SparseMatrixEntry> entries;
-	for (size_t k = 0; k < rows.size(); ++k)
+	// One pass per quadrature node for all entries
+	triangle.quadrature([&e, &local](const FL3& x, double w) {
+		double v[3] = { e[0](x), e[1](x), e[2](x) };
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j <= i; ++j)
+			{
+				local[i][j] += w * v[i] * v[j];
+			}
+		}
+	}, intr);
+	for (int i = 0; i < 3; ++i)
 	{
-		double value = 0;
-
-		// Calculate the common support
-		const auto& support1 = _VF[rows[k]];
-		const auto& support2 = _VF[cols[k]];
-		vector<size_t> support;
-		std::set_intersection(
-			support1.cbegin(), support1.cend(),
-			support2.cbegin(), support2.cend(),
-			std::back_inserter(support)
-		);
-
-		// For each face in the support find the appropriate local stiffness
-		for (auto index : support)
+		for (int j = 0; j < i; ++j)
 		{
-			const auto& fv = _FV[index];
-			size_t i = std::find(fv.cbegin(), fv.cend(), rows[k]) - fv.cbegin();
-			size_t j = std::find(fv.cbegin(), fv.cend(), cols[k]) - fv.cbegin();
-			value += L[index][i][j];
+			local[j][i] = local[i][j];
 		}
-
-		SparseMatrixEntry e;
-		double v = e.value();
-		// Unfortunately, the value() field is private.
-		entries.emplace_back((int)rows[k], (int)cols[k], value);
 	}
-
-	delete[] L;
-
-	M.setFromTriplets(entries.begin(), entries.end());
 }
 
 void
@@ -1980,16 +3801,17 @@ Cartosphere::TriangularMesh::fill(ColVector& b, Function f,
 		{
 			// For each face, obtain the correct element
 			size_t vid = std::find(_FV[star[k]].cbegin(), _FV[star[k]].cend(), i) - _FV[star[k]].cbegin();
-			auto g = _vt[star[k]].element(vid);
-			auto h = [f, g](const Point& p)->double { return f(p) * g(p); };
-			b[i] += _vt[star[k]].integrate(h, intr);
+			Face triangle = face(star[k]);
+			auto g = triangle.basis(vid);
+			auto h = [&f, &g](const Point& p)->double { return f(p) * g(p); };
+			b[i] += triangle.integrate(h, intr);
 
 			// Debug
 			// std::cout
 			// 	<< " V=" << i
 			// 	<< " nb=" << star[k]
 			// 	<< " 1@" << vid
-			// 	<< " I=" << _vt[star[k]].integrate(h, intr) << "\n";
+			// 	<< " I=" << triangle.integrate(h, intr) << "\n";
 		}
 		
 		// Debug
@@ -2003,8 +3825,9 @@ Cartosphere::TriangularMesh::reportAreas()
 	double area = 0;
 	double totalArea = 0;
 
-	for (auto& triangle : _vt)
+	for (size_t i = 0; i < _FV.size(); ++i)
 	{
+		Triangle triangle = face(i).triangle();
 		area = triangle.areaEuclidean();
 		totalArea += area;
 		string message;
@@ -2034,43 +3857,266 @@ Cartosphere::TriangularMesh::reportAreas()
 double
 Cartosphere::TriangularMesh::interpolate(const Point& p) const
 {
-	size_t i = _lookup(p);
-	FL3 c = _vt[i].barycentric(p);
+	return _interpolate(p, _lookup(p));
+}
+
+FL3
+Cartosphere::TriangularMesh::gradient(const Point& p) const
+{
+	return _gradient(p, _lookup(p));
+}
+
+double
+Cartosphere::TriangularMesh::interpolate(const Point& p, size_t& hint) const
+{
+	hint = walk(p, hint);
+	return _interpolate(p, hint);
+}
+
+FL3
+Cartosphere::TriangularMesh::gradient(const Point& p, size_t& hint) const
+{
+	hint = walk(p, hint);
+	return _gradient(p, hint);
+}
+
+size_t
+Cartosphere::TriangularMesh::walk(const Point& p, size_t hint) const
+{
+	if (hint >= _FV.size())
+	{
+		return _lookup(p);
+	}
+
+	// Cross the edge that separates the point the most from the triangle,
+	// until the point is on the inner side of all three edges
+	FL3 x = p.image();
+	size_t f = hint;
+	for (size_t step = 0; step < WalkSteps; ++step)
+	{
+		size_t exit = 3;
+		double worst = 0;
+		for (size_t i = 0; i < 3; ++i)
+		{
+			double side = dot(_FP[3 * f + i], x);
+			if (side < worst)
+			{
+				worst = side;
+				exit = i;
+			}
+		}
+		if (exit == 3)
+		{
+			return f;
+		}
+		if (_FF[f][exit] == NoIndex)
+		{
+			break;
+		}
+		f = _FF[f][exit];
+	}
+	return _lookup(p);
+}
+
+void
+Cartosphere::TriangularMesh::locate(const vector<Point>& p, vector<size_t>& hints) const
+{
+	hints.resize(p.size(), Tree::npos);
+#pragma omp parallel for if (p.size() >= 1024) num_threads(ThreadsMaximum)
+	for (int k = 0; k < (int)p.size(); ++k)
+	{
+		hints[k] = walk(p[k], hints[k]);
+	}
+}
+
+void
+Cartosphere::TriangularMesh::retainHierarchy(bool retain)
+{
+	_HV.clear();
+	_bHierarchy = retain;
+}
+
+void
+Cartosphere::TriangularMesh::_retain_level()
+{
+	vector<Index> coarse;
+	coarse.reserve(3 * _FV.size());
+	for (const auto& v : _FV)
+	{
+		coarse.insert(coarse.end(), v.begin(), v.end());
+	}
+	_HV.push_back(std::move(coarse));
+}
+
+void
+Cartosphere::TriangularMesh::prolongations(vector<SparseMatrixRowMajor>& P) const
+{
+	P.clear();
+	if (!_bHierarchy || _HV.empty())
+	{
+		return;
+	}
+
+	// Mid-point refinement appends the vertices, so the vertices of a level
+	// are a prefix of those of the next
+	vector<size_t> counts(_HV.size() + 1, _V.size());
+	for (size_t l = 0; l < _HV.size(); ++l)
+	{
+		counts[l] = *std::max_element(_HV[l].begin(), _HV[l].end()) + 1;
+	}
+
+	P.resize(_HV.size());
+	for (size_t l = 0; l < _HV.size(); ++l)
+	{
+		size_t coarse = counts[l], fine = counts[l + 1];
+		// Vertices of face k at the next level
+		auto next = [this, l](size_t k) {
+			return l + 1 < _HV.size() ? &_HV[l + 1][3 * k] : _FV[k].data();
+		};
+
+		// The central child of face k has vertices (m2, m0, m1), where m0 is
+		// the midpoint of v0-v1, m1 of v1-v2 and m2 of v2-v0
+		// Both faces across an edge write its midpoint, so this pass is serial
+		vector<std::array<Index, 2>> parents(fine - coarse);
+		for (size_t k = 0; k < _HV[l].size() / 3; ++k)
+		{
+			const Index* v = &_HV[l][3 * k];
+			const Index* m = next(4 * k + 3);
+			parents[m[0] - coarse] = { v[2], v[0] };
+			parents[m[1] - coarse] = { v[0], v[1] };
+			parents[m[2] - coarse] = { v[1], v[2] };
+		}
+
+		// Coarse vertices are kept, and midpoints take the mean of the
+		// endpoints of their edge
+		SparseMatrixRowMajor& Pl = P[l];
+		Pl.resize(fine, coarse);
+		Pl.reserve(Eigen::VectorXi::Constant(fine, 2));
+		for (size_t i = 0; i < coarse; ++i)
+		{
+			Pl.insert(i, i) = 1;
+		}
+		for (size_t i = coarse; i < fine; ++i)
+		{
+			Pl.insert(i, parents[i - coarse][0]) = 0.5;
+			Pl.insert(i, parents[i - coarse][1]) = 0.5;
+		}
+		Pl.makeCompressed();
+	}
+}
+
+size_t
+Cartosphere::TriangularMesh::descend(const Point& p) const
+{
+	if (!_bHierarchy || _FV.empty())
+	{
+		return _lookup_tree(p);
+	}
+
+	FL3 x = p.image();
+	auto side = [this, &x](size_t a, size_t b) {
+		return dot(cross(_V[a].image(), _V[b].image()), x);
+	};
+	// Vertices of face k at level l, the current mesh being the last level
+	auto vertices = [this](size_t l, size_t k) {
+		return l < _HV.size() ? &_HV[l][3 * k] : _FV[k].data();
+	};
+
+	// Base level: the face where the point is least outside of any edge
+	size_t base = _HV.empty() ? _FV.size() : _HV[0].size() / 3;
+	size_t f = 0;
+	double best = -DoubleMaximum;
+	for (size_t k = 0; k < base; ++k)
+	{
+		const Index* v = vertices(0, k);
+		double s = std::min(std::min(side(v[0], v[1]), side(v[1], v[2])), side(v[2], v[0]));
+		if (s > best)
+		{
+			best = s;
+			f = k;
+		}
+	}
+
+	// Each level: the central child has vertices (m2, m0, m1), and the
+	// corner children lie beyond its edges m0-m2, m1-m0 and m2-m1
+	for (size_t l = 1; l <= _HV.size(); ++l)
+	{
+		size_t center = 4 * f + 3;
+		const Index* v = vertices(l, center);
+		size_t m2 = v[0], m0 = v[1], m1 = v[2];
+		if (side(m0, m2) > 0)
+		{
+			f = 4 * f;
+		}
+		else if (side(m1, m0) > 0)
+		{
+			f = 4 * f + 1;
+		}
+		else if (side(m2, m1) > 0)
+		{
+			f = 4 * f + 2;
+		}
+		else
+		{
+			f = center;
+		}
+	}
+	return f;
+}
+
+std::uint64_t
+Cartosphere::TriangularMesh::cell(size_t triangleIndex) const
+{
+	// Bits needed by the base face index
+	size_t base = _HV.empty() ? _FV.size() : _HV[0].size() / 3;
+	size_t bits = 0;
+	while (((size_t)1 << bits) < base)
+	{
+		++bits;
+	}
+	// Face indices already enumerate the children of face k as 4k to 4k+3
+	size_t levels = _bHierarchy ? _HV.size() : 0;
+	return (std::uint64_t)triangleIndex | ((std::uint64_t)1 << (bits + 2 * levels));
+}
+
+double
+Cartosphere::TriangularMesh::_interpolate(const Point& p, size_t i) const
+{
+	FL3 c = face(i).barycentric(p);
 	FL3 v(_a[_FV[i][0]], _a[_FV[i][1]], _a[_FV[i][2]]);
 	double value = dot(c, v);
 	return value;
 }
 
 FL3
-Cartosphere::TriangularMesh::gradient(const Point& p) const
+Cartosphere::TriangularMesh::_gradient(const Point& p, size_t i) const
 {
-	size_t i = _lookup(p);
-
+	Face f = face(i);
 	FL3 u, v, w;
 	if (false)
 	{
-		u = transport(_V[_FV[i][0]], p, _vt[i].gradient(0));
-		v = transport(_V[_FV[i][1]], p, _vt[i].gradient(1));
-		w = transport(_V[_FV[i][2]], p, _vt[i].gradient(2));
+		u = transport(_V[_FV[i][0]], p, f.gradient(0));
+		v = transport(_V[_FV[i][1]], p, f.gradient(1));
+		w = transport(_V[_FV[i][2]], p, f.gradient(2));
 
 		if (u.anynan())
 		{
-			u = _vt[i].gradient(0);
+			u = f.gradient(0);
 		}
 		if (v.anynan())
 		{
-			v = _vt[i].gradient(1);
+			v = f.gradient(1);
 		}
 		if (w.anynan())
 		{
-			w = _vt[i].gradient(2);
+			w = f.gradient(2);
 		}
 	}
 	else
 	{
-		u = _vt[i].gradient(0, p);
-		v = _vt[i].gradient(1, p);
-		w = _vt[i].gradient(2, p);
+		u = f.gradient(0, p);
+		v = f.gradient(1, p);
+		w = f.gradient(2, p);
 		// std::cout << "<" << u << "> <" << v << "> <" << w << "\n";
 	}
 
@@ -2084,10 +4130,10 @@ Cartosphere::TriangularMesh::set(const vector<double>& values)
 	// Initialize an empty gradient field, one vector for each vertex
 	_grad.assign(_V.size(), FL3());
 	// Loop through all the faces
-	for (int k = 0; k < _vt.size(); ++k)
+	for (int k = 0; k < (int)_FV.size(); ++k)
 	{
 		// Face
-		const auto& f = _vt[k];
+		Face f = face(k);
 		// Indices of vertices
 		const auto& v = _FV[k];
 		// Obtain a gradient vector for each vertex.
@@ -2110,9 +4156,9 @@ Cartosphere::TriangularMesh::integrate(const Function& f,
 	{
 	case Quadrature::AreaWeighted:
 	{
-		for (auto& triangle : _vt)
+		for (size_t i = 0; i < _FV.size(); ++i)
 		{
-			result += triangle.integrate(f, intr);
+			result += face(i).integrate(f, intr);
 		}
 	} break;
 	default:
@@ -2136,13 +4182,13 @@ Cartosphere::TriangularMesh::statistics() const
 	s.areaElementMin = DoubleMaximum;
 	s.diameterElementMax = DoubleMinimum;
 
-	for (auto& triangle : _vt)
+	for (size_t i = 0; i < _FV.size(); ++i)
 	{
-		double area = triangle.area();
+		double area = _FA[i];
 		s.areaElementMax = std::max(s.areaElementMax, area);
 		s.areaElementMin = std::min(s.areaElementMin, area);
 
-		double diameter = triangle.diameter();
+		double diameter = face(i).triangle().diameter();
 		s.diameterElementMax = std::max(s.diameterElementMax, diameter);
 	}
 	s.areaElementDisparity = s.areaElementMax / s.areaElementMin;
@@ -2154,11 +4200,29 @@ void
 Cartosphere::TriangularMesh::_populate()
 {
 	// Clear redundant data to regenerate them next
-	_vt.clear();
+	_FA.clear();
+	_FP.clear();
 	_VE.clear();
 	_VF.clear();
 	_FV.clear();
+	_FF.clear();
+	_FC.clear();
+	_slots.clear();
+
+	if (!_populate_faces())
+	{
+		return;
+	}
+	_populate_geometry();
+	_populate_incidence();
+
+	// Construct the fast-lookup structure
+	_tree.build(*this);
+}
 
+bool
+Cartosphere::TriangularMesh::_populate_faces()
+{
 	// Populate triangles
 	size_t pointIndex[6];
 	_FV.resize(_F.size());
@@ -2193,38 +4257,204 @@ Cartosphere::TriangularMesh::_populate()
 			}
 			_vInfo.push_back(message);
 			_bParseSuccess = false;
-			return;
+			return false;
 		}
 
 		// Push triangles that contain redundant information
-		_FV[index] = { pointIndex[0], pointIndex[2], pointIndex[4] };
-		_vt.emplace_back(
-			Point(_V[pointIndex[0]]),
-			Point(_V[pointIndex[2]]),
-			Point(_V[pointIndex[4]])
-		);
+		_FV[index] = { (Index)pointIndex[0], (Index)pointIndex[2], (Index)pointIndex[4] };
 	}
 	_bParseSuccess = true;
 
+	// Populate the faces across each edge, paired through the edge index
+	vector<std::pair<Index, Index>> edgeFace(_E.size(),
+		std::make_pair(NoIndex, NoIndex));
+	_FF.assign(_F.size(), { NoIndex, NoIndex, NoIndex });
+	for (size_t k = 0; k < _F.size(); ++k)
+	{
+		// The i-th edge of a face is opposite its (i+2)-th vertex
+		size_t edges[3] = {
+			std::get<0>(_F[k]).first,
+			std::get<1>(_F[k]).first,
+			std::get<2>(_F[k]).first
+		};
+		for (size_t i = 0; i < 3; ++i)
+		{
+			auto& pair = edgeFace[edges[i]];
+			Index slot = (Index)((i + 2) % 3);
+			if (pair.first == NoIndex)
+			{
+				pair = std::make_pair((Index)k, slot);
+			}
+			else
+			{
+				_FF[k][slot] = pair.first;
+				_FF[pair.first][pair.second] = (Index)k;
+			}
+		}
+	}
+	return true;
+}
+
+void
+Cartosphere::TriangularMesh::_populate_geometry()
+{
+	_FA.resize(_F.size());
+	_FP.resize(3 * _F.size());
+#pragma omp parallel for if (_F.size() >= 1024) num_threads(ThreadsMaximum)
+	for (int k = 0; k < (int)_F.size(); ++k)
+	{
+		Triangle t = face(k).triangle();
+		_FA[k] = t.area();
+		_FP[3 * k + 0] = normalize(cross(t.B.image(), t.C.image()));
+		_FP[3 * k + 1] = normalize(cross(t.C.image(), t.A.image()));
+		_FP[3 * k + 2] = normalize(cross(t.A.image(), t.B.image()));
+	}
+}
+
+void
+Cartosphere::TriangularMesh::_populate_incidence()
+{
 	// Populate the list of edges sharing a vertex
-	_VE.resize(_V.size());
+	vector<Index> keys(_E.size()), values(_E.size());
 	for (size_t k = 0; k < _E.size(); ++k)
 	{
-		_VE[_E[k].first].push_back(k);
+		keys[k] = (Index)_E[k].first;
+		values[k] = (Index)k;
 	}
+	_VE.build(_V.size(), keys, values);
 
 	// Populate the list of faces sharing a vertex
-	_VF.resize(_V.size());
+	keys.resize(3 * _F.size());
+	values.resize(3 * _F.size());
 	for (size_t k = 0; k < _F.size(); ++k)
 	{
-		for (size_t i = 0; i < _FV[k].size(); ++i)
+		for (size_t i = 0; i < 3; ++i)
 		{
-			_VF[_FV[k][i]].push_back(k);
+			keys[3 * k + i] = _FV[k][i];
+			values[3 * k + i] = (Index)k;
 		}
 	}
+	_VF.build(_V.size(), keys, values);
 
-	// Construct the fast-lookup structure
-	//_tree.build(_vt);
+	// Colour the faces greedily so that faces of a colour share no vertex
+	vector<Index> colour(_F.size(), NoIndex);
+	Index colours = 0;
+	vector<bool> used;
+	for (size_t k = 0; k < _F.size(); ++k)
+	{
+		used.assign(colours + 1, false);
+		for (Index v : _FV[k])
+		{
+			for (Index f : _VF[v])
+			{
+				if (colour[f] != NoIndex)
+				{
+					used[colour[f]] = true;
+				}
+			}
+		}
+		colour[k] = (Index)(std::find(used.begin(), used.end(), false) - used.begin());
+		colours = std::max(colours, (Index)(colour[k] + 1));
+	}
+	values.resize(_F.size());
+	std::iota(values.begin(), values.end(), (Index)0);
+	_FC.build(colours, colour, values);
+
+	// Populate the sparsity pattern from the vertices and edges: each row
+	// holds the vertex and its neighbours, sorted
+	Adjacency neighbours;
+	keys.resize(2 * _E.size());
+	values.resize(2 * _E.size());
+	for (size_t k = 0; k < _E.size(); ++k)
+	{
+		keys[2 * k] = values[2 * k + 1] = (Index)_E[k].first;
+		keys[2 * k + 1] = values[2 * k] = (Index)_E[k].second;
+	}
+	neighbours.build(_V.size(), keys, values);
+	vector<Index>().swap(keys);
+	vector<Index>().swap(values);
+	_pattern.resize((int)_V.size(), (int)_V.size());
+	_pattern.resizeNonZeros((Eigen::Index)(_V.size() + neighbours.items.size()));
+	int* rows = _pattern.outerIndexPtr();
+	for (size_t i = 0; i <= _V.size(); ++i)
+	{
+		rows[i] = (int)(i + neighbours.offsets[i]);
+	}
+	int* columns = _pattern.innerIndexPtr();
+#pragma omp parallel for if (_V.size() >= 4096) num_threads(ThreadsMaximum)
+	for (int i = 0; i < (int)_V.size(); ++i)
+	{
+		int* row = columns + rows[i];
+		Adjacency::List list = neighbours[i];
+		std::copy(list.begin(), list.end(), row);
+		row[list.size()] = i;
+		std::sort(row, row + list.size() + 1);
+	}
+	std::fill(_pattern.valuePtr(), _pattern.valuePtr() + _pattern.nonZeros(), 0.0);
+
+	// Locate the entries of each local matrix in the pattern
+	_slots.resize(9 * _F.size());
+	const int* outer = _pattern.outerIndexPtr();
+	const int* inner = _pattern.innerIndexPtr();
+#pragma omp parallel for if (_F.size() >= 4096) num_threads(ThreadsMaximum)
+	for (int k = 0; k < (int)_F.size(); ++k)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			int row = (int)_FV[k][i];
+			for (int j = 0; j < 3; ++j)
+			{
+				int col = (int)_FV[k][j];
+				_slots[9 * k + 3 * i + j] = (int)(std::lower_bound(
+					inner + outer[row], inner + outer[row + 1], col) - inner);
+			}
+		}
+	}
+}
+
+void
+Cartosphere::TriangularMesh::Adjacency::build(size_t lists,
+	const vector<Index>& keys, const vector<Index>& values)
+{
+	// Count, then accumulate into offsets, then place
+	offsets.assign(lists + 1, 0);
+	for (Index key : keys)
+	{
+		++offsets[key + 1];
+	}
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+	items.resize(keys.size());
+	vector<Index> next(offsets.begin(), offsets.end() - 1);
+	for (size_t k = 0; k < keys.size(); ++k)
+	{
+		items[next[keys[k]]++] = values[k];
+	}
+}
+
+void
+Cartosphere::TriangularMesh::_assemble(SparseMatrixRowMajor& A,
+	const double (*L)[3][3]) const
+{
+	// Faces of a colour share no vertex, and hence no slot
+	A = _pattern;
+	double* values = A.valuePtr();
+	for (size_t c = 0; c < _FC.size(); ++c)
+	{
+		Adjacency::List faces = _FC[c];
+#pragma omp parallel for if (faces.size() >= 1024) num_threads(ThreadsMaximum)
+		for (int n = 0; n < (int)faces.size(); ++n)
+		{
+			size_t k = faces[n];
+			const int* slots = &_slots[9 * k];
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					values[slots[3 * i + j]] += L[k][i][j];
+				}
+			}
+		}
+	}
 }
 
 void
@@ -2234,10 +4464,10 @@ Cartosphere::TriangularMesh::_gradient(const vector<double>& a)
 
 	for (int i = 0; i < _FV.size(); ++i)
 	{
-		vector<size_t> V = _FV[i];
+		const IndexTriplet& V = _FV[i];
 		for (int j = 0; j < 3; ++j)
 		{
-			_grad[V[j]] += a[i] * _vt[i].gradient(j);
+			_grad[V[j]] += a[i] * face(i).gradient(j);
 		}
 	}
 }
@@ -2245,9 +4475,33 @@ Cartosphere::TriangularMesh::_gradient(const vector<double>& a)
 size_t
 Cartosphere::TriangularMesh::_lookup(const Point& p) const
 {
-	for (size_t i = 0; i < _vt.size(); ++i)
+	// The hierarchy needs no tolerances, so prefer it if kept
+	if (_bHierarchy && !_FV.empty())
+	{
+		return descend(p);
+	}
+	return _lookup_tree(p);
+}
+
+size_t
+Cartosphere::TriangularMesh::_lookup_tree(const Point& p) const
+{
+	// Points on shared edges might slip between the tolerances, so fall back
+	// to the linear scan if the tree finds nothing
+	size_t i = _tree.find(p, *this);
+	if (i != Tree::npos)
+	{
+		return i;
+	}
+	return _lookup_linear(p);
+}
+
+size_t
+Cartosphere::TriangularMesh::_lookup_linear(const Point& p) const
+{
+	for (size_t i = 0; i < _FV.size(); ++i)
 	{
-		if (_vt[i].contains(p))
+		if (face(i).contains(p))
 		{
 			return i;
 		}
@@ -0,0 +1,229 @@
+
+#include "cartosphere/raster.hpp"
+using Cartosphere::Rasterizer;
+
+void
+Rasterizer::add(const Region& rings, double value)
+{
+	vector<Edge> edges;
+	vector<double> seams;
+	bool north = false;
+
+	for (const auto& ring : rings)
+	{
+		const vector<Point>& V = ring.vertices();
+		const size_t n = V.size();
+		if (n < 3)
+		{
+			continue;
+		}
+
+		double winding = 0;
+		double polar = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			const Point& P = V[i];
+			const Point& Q = V[(i + 1) % n];
+
+			// Tail azimuth in [0, 2pi), head unwrapped along the short way
+			double a1 = fmod(P.a(), 2 * M_PI);
+			if (a1 < 0)
+			{
+				a1 += 2 * M_PI;
+			}
+			double delta = remainder(Q.a() - P.a(), 2 * M_PI);
+			double a2 = a1 + delta;
+			edges.push_back({ P.p(), a1, Q.p(), a2 });
+
+			// Record where the edge crosses the azimuth 0
+			if (a2 < 0 || a2 >= 2 * M_PI)
+			{
+				double seam = (a2 < 0) ? 0 : 2 * M_PI;
+				seams.push_back(P.p() + (Q.p() - P.p()) * (seam - a1) / delta);
+			}
+
+			winding += delta;
+			polar += P.p();
+		}
+
+		// A ring winding around the polar axis encloses one pole
+		// Take the pole on the same hemisphere as the ring itself
+		if (fabs(winding) > M_PI && polar / n < M_PI_2)
+		{
+			north = !north;
+		}
+	}
+	std::sort(seams.begin(), seams.end());
+
+	_edges.push_back(std::move(edges));
+	_seams.push_back(std::move(seams));
+	_north.push_back(north);
+	_values.push_back(value);
+}
+
+void
+Rasterizer::add(const Cartosphere::Polygon& ring, double value)
+{
+	add(Region{ ring }, value);
+}
+
+void
+Rasterizer::clear()
+{
+	_edges.clear();
+	_seams.clear();
+	_north.clear();
+	_values.clear();
+}
+
+void
+Rasterizer::rasterize(int B, double* grid) const
+{
+	const int N = 2 * B;
+	const int S = _subrings;
+	const size_t R = _values.size();
+	const double h = M_PI / N;
+
+	// Bucket the edges of each region by the polar rings they span
+	vector<vector<vector<size_t>>> buckets(R, vector<vector<size_t>>(N));
+	for (size_t r = 0; r < R; ++r)
+	{
+		for (size_t e = 0; e < _edges[r].size(); ++e)
+		{
+			const Edge& edge = _edges[r][e];
+			int j0 = (int)floor(std::min(edge.p1, edge.p2) / h);
+			int j1 = (int)floor(std::max(edge.p1, edge.p2) / h);
+			j0 = std::max(j0, 0);
+			j1 = std::min(j1, N - 1);
+			for (int j = j0; j <= j1; ++j)
+			{
+				buckets[r][j].push_back(e);
+			}
+		}
+	}
+
+	// Each polar ring is independent
+#pragma omp parallel for if (N >= 64) num_threads(ThreadsMaximum)
+	for (int j = 0; j < N; ++j)
+	{
+		double* row = grid + (size_t)N * j;
+		std::fill(row, row + N, 0.0);
+
+		// Sub-scanlines at the midpoints of the ring, weighted by area
+		vector<double> polar(S), weight(S);
+		double sum = 0;
+		for (int s = 0; s < S; ++s)
+		{
+			polar[s] = h * (j + (s + 0.5) / S);
+			weight[s] = sin(polar[s]);
+			sum += weight[s];
+		}
+		for (int s = 0; s < S; ++s)
+		{
+			weight[s] /= sum;
+		}
+
+		// Coverage of the current region and of all regions so far
+		vector<double> coverage(N), total(N);
+		vector<double> xs;
+		for (size_t r = 0; r < R; ++r)
+		{
+			bool covered = false;
+			for (int s = 0; s < S; ++s)
+			{
+				covered |= _scan(r, polar[s], weight[s], buckets[r][j], xs,
+					N, coverage.data());
+			}
+			if (!covered)
+			{
+				continue;
+			}
+			for (int k = 0; k < N; ++k)
+			{
+				row[k] += _values[r] * coverage[k];
+				total[k] += coverage[k];
+				coverage[k] = 0;
+			}
+		}
+
+		// Overlapping regions share the cell; otherwise the background
+		// fills the uncovered remainder
+		for (int k = 0; k < N; ++k)
+		{
+			if (total[k] > 1)
+			{
+				row[k] /= total[k];
+			}
+			else
+			{
+				row[k] += _background * (1 - total[k]);
+			}
+		}
+	}
+}
+
+bool
+Rasterizer::_scan(size_t r, double p, double weight,
+	const vector<size_t>& edges, vector<double>& xs,
+	int N, double* coverage) const
+{
+	// Azimuths where the scanline crosses the region boundary
+	xs.clear();
+	for (size_t e : edges)
+	{
+		const Edge& edge = _edges[r][e];
+		if ((edge.p1 <= p) != (edge.p2 <= p))
+		{
+			double a = edge.a1 + (p - edge.p1) / (edge.p2 - edge.p1) * (edge.a2 - edge.a1);
+			a = fmod(a, 2 * M_PI);
+			if (a < 0)
+			{
+				a += 2 * M_PI;
+			}
+			xs.push_back(a);
+		}
+	}
+
+	// Parity at azimuth 0, walking down from the north pole
+	const auto& seams = _seams[r];
+	size_t crossings = std::lower_bound(seams.begin(), seams.end(), p) - seams.begin();
+	bool inside = _north[r] != (crossings % 2 == 1);
+	if (xs.empty() && !inside)
+	{
+		return false;
+	}
+	std::sort(xs.begin(), xs.end());
+
+	// Accumulate the covered fraction of each cell along the scanline
+	const double w = 2 * M_PI / N;
+	auto cover = [&](double a, double b) {
+		int k0 = std::min((int)(a / w), N - 1);
+		int k1 = std::min((int)(b / w), N - 1);
+		if (k0 == k1)
+		{
+			coverage[k0] += weight * (b - a) / w;
+			return;
+		}
+		coverage[k0] += weight * ((k0 + 1) * w - a) / w;
+		for (int k = k0 + 1; k < k1; ++k)
+		{
+			coverage[k] += weight;
+		}
+		coverage[k1] += weight * (b - k1 * w) / w;
+	};
+	double from = 0;
+	for (double x : xs)
+	{
+		if (inside)
+		{
+			cover(from, x);
+		}
+		inside = !inside;
+		from = x;
+	}
+	if (inside)
+	{
+		cover(from, 2 * M_PI);
+	}
+	return true;
+}
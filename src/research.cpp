@@ -13,6 +13,10 @@ using Cartosphere::ShapeFile;
 
 #include "cartosphere/functions.hpp"
 
+#include "cartosphere/cartosphere.hpp"
+using Cartosphere::Rasterizer;
+using Cartosphere::SpectralGlobe;
+
 void build_system(const TriangularMesh& mesh, SparseMatrixRowMajor& A, ColVector& b)
 {
 	mesh.fill(A);
@@ -23,6 +27,23 @@ void build_system(const TriangularMesh& mesh, SparseMatrixRowMajor& A, ColVector
 	mesh.fill(b, f);
 }
 
+// Seconds elapsed between two time points of a benchmark
+static double seconds(steady_clock::time_point begin, steady_clock::time_point end)
+{
+	return duration_cast<std::chrono::microseconds>(end - begin).count() / 1e6;
+}
+
+// Generate a refined icosahedron for a benchmark, reporting failure
+static bool generate_icosahedron(TriangularMesh& mesh, int level)
+{
+	if (!mesh.generate(TriangularMesh::Polyhedron::Icosahedron, level))
+	{
+		std::cerr << "Cannot generate the mesh\n";
+		return false;
+	}
+	return true;
+}
+
 int demo()
 {
 	string file = "icosahedron.csm";
@@ -852,11 +873,12 @@ int research_d()
 	s.set(m);
 	s.set([](const Point& x) -> double { return 0; });
 	s.initialize([](const Point& x) -> double { return 2 + x.z(); });
+	vector<size_t> hints;
 	for (size_t k = 0; k + 1 < t.size(); ++k)
 	{
 		double duration = t[k + 1] - t[k];
 		s.advance(duration);
-		vector<FL3> u = s.velocity(p);
+		vector<FL3> u = s.velocity(p, hints);
 		vector<Point> q = p;
 		for (size_t i = 0; i < p.size(); ++i)
 		{
@@ -946,9 +968,10 @@ int research_f()
 		double dist_max = std::numeric_limits<double>::max();
 		double vertex_change = std::numeric_limits<double>::max();
 		solver.advance(duration/2);
+		vector<size_t> hints;
 		while (cumulative < time_max && vertex_change > 1e-6)
 		{
-			vector<FL3> u = solver.velocity(p);
+			vector<FL3> u = solver.velocity(p, hints);
 			vector<Point> q = p;
 			dist_max = 0;
 			for (size_t i = 0; i < p.size(); ++i)
@@ -1014,3 +1037,831 @@ int research_g(const string &folder)
 
 	return 0;
 }
+
+int benchmark_raster(int bandlimit)
+{
+	// Synthetic national boundaries: 200 wiggly, disjoint regions of 500
+	// vertices each, on a 10 x 20 grid away from the poles and the seam
+	const int rows = 10, columns = 20, vertices = 500;
+	std::mt19937 generator(2023);
+	std::uniform_real_distribution<double> uniform(0, 1);
+	vector<Cartosphere::Polygon> rings;
+	vector<double> values;
+	for (int i = 0; i < rows; ++i)
+	{
+		for (int j = 0; j < columns; ++j)
+		{
+			double p0 = 0.3 + (M_PI - 0.6) * (i + 0.5) / rows;
+			double a0 = 0.3 + (2 * M_PI - 0.6) * (j + 0.5) / columns;
+			double phase = 2 * M_PI * uniform(generator);
+			Cartosphere::Polygon ring;
+			for (int k = 0; k < vertices; ++k)
+			{
+				double t = 2 * M_PI * k / vertices;
+				double r = 0.07 * (1 + 0.3 * sin(7 * t + phase));
+				ring.emplace_back(p0 + r * cos(t), a0 + r * sin(t));
+			}
+			rings.push_back(ring);
+			values.push_back(1 + uniform(generator));
+		}
+	}
+
+	// The per-cell path: bounding boxes, then even-odd crossings in the
+	// (polar, azimuth) plane, the same rule Rasterizer applies
+	struct Box
+	{
+		double p1, p2, a1, a2;
+		vector<double> p, a;
+	};
+	vector<Box> boxes(rings.size());
+	for (size_t r = 0; r < rings.size(); ++r)
+	{
+		Box& box = boxes[r];
+		box.p1 = box.a1 = DoubleMaximum;
+		box.p2 = box.a2 = -DoubleMaximum;
+		for (const Point& v : rings[r].vertices())
+		{
+			box.p.push_back(v.p());
+			box.a.push_back(v.a());
+			box.p1 = std::min(box.p1, v.p());
+			box.p2 = std::max(box.p2, v.p());
+			box.a1 = std::min(box.a1, v.a());
+			box.a2 = std::max(box.a2, v.a());
+		}
+	}
+	Function sample = [&boxes, &values](const Point& x) -> double {
+		double p = x.p(), a = x.a();
+		for (size_t r = 0; r < boxes.size(); ++r)
+		{
+			const Box& box = boxes[r];
+			if (p < box.p1 || p > box.p2 || a < box.a1 || a > box.a2)
+			{
+				continue;
+			}
+			bool inside = false;
+			size_t n = box.p.size();
+			for (size_t i = 0, j = n - 1; i < n; j = i++)
+			{
+				if ((box.p[i] > p) != (box.p[j] > p)
+					&& a < box.a[j] + (box.a[i] - box.a[j])
+						* (p - box.p[j]) / (box.p[i] - box.p[j]))
+				{
+					inside = !inside;
+				}
+			}
+			if (inside)
+			{
+				return values[r];
+			}
+		}
+		return 0;
+	};
+
+	Rasterizer raster;
+	for (size_t r = 0; r < rings.size(); ++r)
+	{
+		raster.add(rings[r], values[r]);
+	}
+
+	std::cout << "Initial data of " << rings.size() << " regions, "
+		<< rings.size() * vertices << " vertices: per-cell sampling vs rasterization\n"
+		<< "  Only cells cut by a boundary should differ.\n\n"
+		<< "  | bandlimit |     cells | sampling (s) | rasterize (s) | speedup |"
+		<< " differing cells |\n"
+		<< "  | ---------:| ---------:| ------------:| -------------:| -------:|"
+		<< " ---------------:|\n";
+
+	for (int B = 64; B <= bandlimit; B *= 2)
+	{
+		int N = 2 * B;
+
+		// Sample at the cell centres, as SpectralGlobe::initialize_solver does
+		// with an initial condition; both paths share the transform after
+		vector<double> sampled(N * N);
+		auto t0 = steady_clock::now();
+		for (int j = 0; j < N; ++j)
+		{
+			double theta = M_PI / N * (j + 0.5);
+			for (int k = 0; k < N; ++k)
+			{
+				double phi = M_PI / B * (k + 0.5);
+				sampled[N * j + k] = sample(Point(theta, phi));
+			}
+		}
+		auto t1 = steady_clock::now();
+
+		vector<double> rasterized(N * N);
+		raster.rasterize(B, rasterized.data());
+		auto t2 = steady_clock::now();
+
+		size_t differing = 0;
+		for (int i = 0; i < N * N; ++i)
+		{
+			differing += std::abs(sampled[i] - rasterized[i]) > 1e-9;
+		}
+
+		double timeSampling = seconds(t0, t1);
+		double timeRaster = seconds(t1, t2);
+		std::cout << "  | " << std::setw(9) << B
+			<< " | " << std::setw(9) << N * N
+			<< " | " << std::setw(12) << timeSampling
+			<< " | " << std::setw(13) << timeRaster
+			<< " | " << std::setw(7) << (timeRaster > 0 ? timeSampling / timeRaster : 0)
+			<< " | " << std::setw(15) << differing << " |\n" << std::flush;
+	}
+
+	return 0;
+}
+
+int benchmark_resume(int bandlimit)
+{
+	const int iterations = 40;
+	const string path = "benchmark_resume.csck";
+
+	// Points on the equator, moved by the diffusion of 2 + z
+	vector<Point> initial;
+	for (int k = 0; k < 360; ++k)
+	{
+		initial.emplace_back(cos(cs_deg2rad(k)), sin(cs_deg2rad(k)), 0.0);
+	}
+	auto configure = [bandlimit](SpectralGlobe& globe, int maxIterations) {
+		globe.set_bandlimit(bandlimit);
+		globe.set_first_timestep(1e-2);
+		globe.set_eps_distance(0);
+		globe.set_max_iterations(maxIterations);
+		globe.set_initial_condition([](const Point& x) -> double { return 2 + x.z(); });
+	};
+
+	std::cout << "Checkpoint and resume of a spectral transform (bandlimit "
+		<< bandlimit << ", " << initial.size() << " points, "
+		<< iterations << " iterations)\n"
+		<< "  The run is stopped halfway with a checkpoint every 10 iterations,\n"
+		<< "  then resumed from the file by a fresh globe.\n\n"
+		<< "  | run            | iterations |   time (s) | max distance to uninterrupted |\n"
+		<< "  | -------------- | ----------:| ----------:| -----------------------------:|\n";
+	auto report = [&initial](const string& run, size_t steps, double time,
+		const vector<Point>& points, const vector<Point>& reference) {
+		double farthest = 0;
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			farthest = std::max(farthest, (points[i].image() - reference[i].image()).norm2());
+		}
+		std::cout << "  | " << std::left << std::setw(14) << run << std::right
+			<< " | " << std::setw(10) << steps
+			<< " | " << std::setw(10) << time
+			<< " | " << std::setw(29) << farthest << " |\n" << std::flush;
+	};
+
+	// Uninterrupted
+	vector<Point> reference = initial;
+	auto t0 = steady_clock::now();
+	{
+		SpectralGlobe globe;
+		configure(globe, iterations);
+		globe.initialize_solver();
+		globe.transform(reference);
+	}
+	auto t1 = steady_clock::now();
+	report("uninterrupted", iterations, seconds(t0, t1), reference, reference);
+
+	// Stopped halfway, checkpointing on the way
+	vector<Point> stopped = initial;
+	{
+		SpectralGlobe globe;
+		configure(globe, iterations / 2);
+		globe.enable_checkpoint(path, 10);
+		globe.initialize_solver();
+		globe.transform(stopped);
+		if (!globe.get_checkpoint_error().empty())
+		{
+			std::cerr << "Error: " << globe.get_checkpoint_error() << "\n";
+			return 1;
+		}
+	}
+	auto t2 = steady_clock::now();
+	report("stopped", iterations / 2, seconds(t1, t2), stopped, reference);
+
+	// Resumed without initialize_solver
+	vector<Point> resumed;
+	{
+		SpectralGlobe globe;
+		configure(globe, iterations);
+		string error;
+		if (!globe.resume(path, resumed, error))
+		{
+			std::cerr << "Error: " << error << "\n";
+			return 1;
+		}
+	}
+	auto t3 = steady_clock::now();
+	report("resumed", iterations - iterations / 2, seconds(t2, t3), resumed, reference);
+	std::filesystem::remove(path);
+
+	// A checkpoint that cannot be written is reported after the transform
+	{
+		SpectralGlobe globe;
+		configure(globe, 10);
+		globe.enable_checkpoint("nonexistent/" + path, 5);
+		globe.initialize_solver();
+		vector<Point> points = initial;
+		globe.transform(points);
+		std::cout << "\n  Unwritable checkpoint: " << globe.get_checkpoint_error() << "\n";
+	}
+
+	return 0;
+}
+
+int benchmark_lookup(int levels)
+{
+	std::cout << "Point location on refined icosahedra: linear scan vs SS-tree"
+		<< " vs refinement hierarchy\n"
+		<< "  10000 uniformly random points per mesh.\n\n"
+		<< "  | level |       F | height |  build (s) | linear (s) |   tree (s) | speedup |"
+		<< " hierarchy (s) | mismatches |\n"
+		<< "  | -----:| -------:| ------:| ----------:| ----------:| ----------:| -------:|"
+		<< " -------------:| ----------:|\n";
+
+	// Uniformly random points
+	std::mt19937 generator(2023);
+	std::normal_distribution<double> normal;
+	vector<Point> points;
+	for (int i = 0; i < 10000; ++i)
+	{
+		FL3 x(normal(generator), normal(generator), normal(generator));
+		points.emplace_back(Cartosphere::Image(x.normalize()));
+	}
+
+	TriangularMesh mesh("icosahedron.csm");
+	if (!mesh.isReady())
+	{
+		std::cerr << "Cannot load icosahedron.csm\n";
+		return 1;
+	}
+	mesh.retainHierarchy();
+	for (int level = 0; level <= levels; ++level)
+	{
+		// Refinement rebuilds the tree, so time it on its own
+		auto t0 = steady_clock::now();
+		if (level > 0)
+		{
+			mesh.refine();
+		}
+		auto t1 = steady_clock::now();
+
+		// The linear scan gets slow quickly, so sample fewer points
+		size_t sampled = std::min(points.size(), (size_t)(2e8 / (20 << (2 * level))));
+		vector<size_t> linear(sampled);
+		for (size_t i = 0; i < sampled; ++i)
+		{
+			linear[i] = mesh.locate(points[i], false);
+		}
+		auto t2 = steady_clock::now();
+
+		vector<size_t> tree(points.size());
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			tree[i] = mesh.locate(points[i], true);
+		}
+		auto t3 = steady_clock::now();
+
+		vector<size_t> hierarchy(points.size());
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			hierarchy[i] = mesh.descend(points[i]);
+		}
+		auto t4 = steady_clock::now();
+
+		// Points on shared edges may legitimately land in either triangle
+		size_t mismatches = 0;
+		for (size_t i = 0; i < sampled; ++i)
+		{
+			mismatches += (linear[i] != tree[i]);
+		}
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			mismatches += (hierarchy[i] != tree[i]);
+		}
+
+		double build = seconds(t0, t1);
+		double timeLinear = seconds(t1, t2) * points.size() / sampled;
+		double timeTree = seconds(t2, t3);
+		double timeHierarchy = seconds(t3, t4);
+		std::cout << "  | " << std::setw(5) << level
+			<< " | " << std::setw(7) << mesh.statistics().F
+			<< " | " << std::setw(6) << mesh.treeHeight()
+			<< " | " << std::setw(10) << build
+			<< " | " << std::setw(10) << timeLinear
+			<< " | " << std::setw(10) << timeTree
+			<< " | " << std::setw(7) << (timeTree > 0 ? timeLinear / timeTree : 0)
+			<< " | " << std::setw(13) << timeHierarchy
+			<< " | " << std::setw(10) << mismatches << " |\n" << std::flush;
+	}
+
+	return 0;
+}
+
+int benchmark_quadrature(int level)
+{
+	// The integral of exp(k.x) over the sphere is 4 pi sinh(|k|) / |k|
+	FL3 k(3, 2, 1);
+	double exact = 4 * M_PI * std::sinh(k.norm2()) / k.norm2();
+	auto f = [&k](const Point& p) -> double {
+		return std::exp(dot(k, p.image()));
+	};
+
+	TriangularMesh mesh("icosahedron.csm");
+	if (!mesh.isReady())
+	{
+		std::cerr << "Cannot load icosahedron.csm\n";
+		return 1;
+	}
+	for (int l = 0; l < level; ++l)
+	{
+		mesh.refine();
+	}
+	size_t F = mesh.statistics().F;
+
+	std::cout << "Quadrature of exp(3x+2y+z) over a refined icosahedron\n"
+		<< "  Refinement level " << level << ", " << F << " triangles.\n\n"
+		<< "  | rule          | nodes | evaluations | relative error |   time (s) |\n"
+		<< "  | ------------- | -----:| -----------:| --------------:| ----------:|\n";
+
+	vector<std::pair<string, Triangle::Integrator>> rules = {
+		{ "Centroid", Triangle::Integrator::Centroid },
+		{ "ThreeVertices", Triangle::Integrator::ThreeVertices },
+		{ "Simpsons", Triangle::Integrator::Simpsons }
+	};
+	for (int r = 1; r <= 7; ++r)
+	{
+		rules.emplace_back("Refinement" + std::to_string(r), (Triangle::Integrator)
+			((int)Triangle::Integrator::Refinement1 + r - 1));
+	}
+	for (int d = 2; d <= 20; ++d)
+	{
+		rules.emplace_back("Gauss" + std::to_string(d), (Triangle::Integrator)
+			((int)Triangle::Integrator::Gauss2 + d - 2));
+	}
+
+	for (const auto& rule : rules)
+	{
+		// Build the tables outside of the timing
+		size_t nodes = Triangle::evaluations(rule.second);
+		auto t0 = steady_clock::now();
+		double integral = mesh.integrate(f,
+			TriangularMesh::Quadrature::AreaWeighted, rule.second);
+		auto t1 = steady_clock::now();
+		double error = std::abs(integral - exact) / exact;
+		double elapsed = seconds(t0, t1);
+		std::cout << "  | " << std::left << std::setw(13) << rule.first << std::right
+			<< " | " << std::setw(5) << nodes
+			<< " | " << std::setw(11) << nodes * F
+			<< " | " << std::setw(14) << std::setprecision(3) << error
+			<< " | " << std::setw(10) << std::setprecision(6) << elapsed << " |\n";
+	}
+
+	return 0;
+}
+
+int benchmark_adapt(int levels)
+{
+	// A steep front around a cap, like a dense city next to empty ocean
+	FL3 center = normalize(FL3(0.3, 0.5, 0.8));
+	auto f = [&center](const Point& p) -> double {
+		return std::tanh(30 * (dot(center, p.image()) - 0.9));
+	};
+	auto sample = [&f](const TriangularMesh& mesh) {
+		vector<Point> points = mesh.vertices();
+		vector<double> values(points.size());
+		std::transform(points.begin(), points.end(), values.begin(), f);
+		return values;
+	};
+
+	TriangularMesh mesh("icosahedron.csm");
+	if (!mesh.isReady())
+	{
+		std::cerr << "Cannot load icosahedron.csm\n";
+		return 1;
+	}
+
+	std::cout << "Interpolation of tanh(30 (c.x - 0.9)): uniform vs adaptive"
+		<< " refinement\n\n"
+		<< "  | mesh            |       V |   L2 error |  adapt (s) |\n"
+		<< "  | --------------- | -------:| ----------:| ----------:|\n";
+	TriangularMesh adaptive;
+	size_t budget = 0;
+	for (int level = 0; level <= levels; ++level)
+	{
+		if (level > 0)
+		{
+			mesh.refine();
+		}
+		if (level == std::min(levels, 2))
+		{
+			adaptive = mesh;
+		}
+		budget = mesh.statistics().V;
+		std::cout << "  | uniform " << std::left << std::setw(7) << level << std::right
+			<< " | " << std::setw(7) << budget
+			<< " | " << std::setw(10) << mesh.lebesgue(sample(mesh), f)
+			<< " | " << std::setw(10) << "-" << " |\n";
+	}
+
+	// Bisect the faces holding half of the estimated error until the
+	// adaptive mesh has as many vertices as the finest uniform mesh
+	for (int round = 1; adaptive.statistics().V < budget; ++round)
+	{
+		size_t V = adaptive.statistics().V;
+		adaptive.set(sample(adaptive));
+		auto t0 = steady_clock::now();
+		adaptive.adapt(0.5);
+		auto t1 = steady_clock::now();
+		if (adaptive.statistics().V == V)
+		{
+			break;
+		}
+		double elapsed = seconds(t0, t1);
+		std::cout << "  | adaptive " << std::left << std::setw(6) << round << std::right
+			<< " | " << std::setw(7) << adaptive.statistics().V
+			<< " | " << std::setw(10) << adaptive.lebesgue(sample(adaptive), f)
+			<< " | " << std::setw(10) << elapsed << " |\n";
+	}
+
+	return 0;
+}
+
+int benchmark_reorder(int level)
+{
+	std::cout << "Vertex numbering on a refined icosahedron (level " << level
+		<< "): refinement order vs Hilbert curve vs reverse Cuthill-McKee\n"
+		<< "  SpMV throughput of the stiffness matrix, 50 products.\n\n"
+		<< "  | ordering      | reorder (s) |  bandwidth | mean |i-j| |   fill (s) |"
+		<< "  SpMV (s) | SpMV (GFlop/s) |    set (s) |\n"
+		<< "  | ------------- | -----------:| ----------:| ----------:| ----------:|"
+		<< " ---------:| --------------:| ----------:|\n";
+
+	vector<std::pair<string, int>> orderings = {
+		{ "refinement", -1 },
+		{ "Hilbert", (int)TriangularMesh::Ordering::Hilbert },
+		{ "Cuthill-McKee", (int)TriangularMesh::Ordering::CuthillMcKee },
+	};
+	for (const auto& ordering : orderings)
+	{
+		TriangularMesh mesh;
+		if (!generate_icosahedron(mesh, level))
+		{
+			return 1;
+		}
+		auto t0 = steady_clock::now();
+		if (ordering.second >= 0)
+		{
+			mesh.reorder((TriangularMesh::Ordering)ordering.second);
+		}
+		auto t1 = steady_clock::now();
+
+		SparseMatrixRowMajor A;
+		mesh.fill(A, Triangle::Integrator::Gauss6);
+		auto t2 = steady_clock::now();
+
+		// Distance of the entries from the diagonal
+		size_t bandwidth = 0;
+		double distance = 0;
+		for (int k = 0; k < A.outerSize(); ++k)
+		{
+			for (SparseMatrixRowMajor::InnerIterator it(A, k); it; ++it)
+			{
+				size_t d = std::abs(it.row() - it.col());
+				bandwidth = std::max(bandwidth, d);
+				distance += d;
+			}
+		}
+		distance /= A.nonZeros();
+
+		ColVector x = ColVector::Ones(A.cols()), y;
+		auto t3 = steady_clock::now();
+		for (int r = 0; r < 50; ++r)
+		{
+			y = A * x;
+			x = y.normalized();
+		}
+		auto t4 = steady_clock::now();
+
+		vector<Point> points = mesh.vertices();
+		vector<double> values(points.size());
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			values[i] = points[i].z();
+		}
+		auto t5 = steady_clock::now();
+		mesh.set(values);
+		auto t6 = steady_clock::now();
+
+		double spmv = seconds(t3, t4);
+		std::cout << "  | " << std::left << std::setw(13) << ordering.first << std::right
+			<< " | " << std::setw(11) << seconds(t0, t1)
+			<< " | " << std::setw(10) << bandwidth
+			<< " | " << std::setw(10) << distance
+			<< " | " << std::setw(10) << seconds(t1, t2)
+			<< " | " << std::setw(9) << spmv
+			<< " | " << std::setw(14) << 2.0 * 50 * A.nonZeros() / spmv / 1e9
+			<< " | " << std::setw(10) << seconds(t5, t6) << " |\n";
+	}
+
+	return 0;
+}
+
+int benchmark_factorization(int level)
+{
+	TriangularMesh mesh;
+	if (!generate_icosahedron(mesh, level))
+	{
+		return 1;
+	}
+	mesh.reorder();
+
+	const int steps = 20;
+	std::cout << "Backward Euler on a refined icosahedron (level " << level
+		<< ", V = " << mesh.statistics().V << "): cached factorisations\n"
+		<< "  " << steps << " steps of a constant or geometric (ratio 1.01)"
+		<< " timestep schedule.\n\n"
+		<< "  | solver             | schedule  | first (s) |   step (s) |"
+		<< " hit rate |  max |a - a_ldlt| |\n"
+		<< "  | ------------------ | --------- | ---------:| ----------:|"
+		<< " --------:| -----------------:|\n";
+
+	vector<std::pair<string, TimeDependentSolver::LinearSolver>> solvers = {
+		{ "LDLT", TimeDependentSolver::LinearSolver::LDLT },
+		{ "CG + IC", TimeDependentSolver::LinearSolver::ConjugateGradient },
+	};
+	for (double ratio : { 1.0, 1.01 })
+	{
+		vector<double> reference;
+		for (const auto& solver : solvers)
+		{
+			TimeDependentSolver s;
+			s.set(mesh);
+			s.set(solver.second);
+			s.set([](const Point&) -> double { return 0; });
+			s.initialize([](const Point& x) -> double { return 2 + x.z(); });
+
+			double timestep = 1e-3;
+			auto t0 = steady_clock::now();
+			s.advance(timestep);
+			auto t1 = steady_clock::now();
+			for (int k = 1; k < steps; ++k)
+			{
+				timestep *= ratio;
+				s.advance(timestep);
+			}
+			auto t2 = steady_clock::now();
+
+			// Compare against the direct solution of the same schedule
+			const vector<double>& values = s.values();
+			double difference = 0;
+			if (reference.empty())
+			{
+				reference = values;
+			}
+			for (size_t i = 0; i < values.size(); ++i)
+			{
+				difference = std::max(difference, std::abs(values[i] - reference[i]));
+			}
+
+			std::cout << "  | " << std::left << std::setw(18) << solver.first
+				<< " | " << std::setw(9) << (ratio == 1 ? "constant" : "geometric")
+				<< std::right
+				<< " | " << std::setw(9) << seconds(t0, t1)
+				<< " | " << std::setw(10) << seconds(t1, t2) / (steps - 1)
+				<< " | " << std::setw(8) << s.statistics().rate()
+				<< " | " << std::setw(17) << difference << " |\n";
+		}
+	}
+
+	return 0;
+}
+
+int benchmark_multigrid(int levels)
+{
+	std::cout << "Poisson (A) and diffusion (A + M/0.01) systems on refined"
+		<< " icosahedra: BiCGSTAB + ILUT vs multigrid-preconditioned CG\n"
+		<< "  Right-hand side M z; iterations and seconds including the set-up.\n\n"
+		<< "  | level |       V | system    | BiCGSTAB | BiCGSTAB (s) |"
+		<< " V-cycle |  V-cycle (s) | W-cycle |  W-cycle (s) |\n"
+		<< "  | -----:| -------:| --------- | --------:| ------------:|"
+		<< " -------:| ------------:| -------:| ------------:|\n";
+
+	using Cartosphere::Multigrid;
+	for (int level = 1; level <= levels; ++level)
+	{
+		TriangularMesh mesh;
+		if (!generate_icosahedron(mesh, level))
+		{
+			return 1;
+		}
+		SparseMatrixRowMajor A, M;
+		mesh.fill(A, M, Triangle::Integrator::Gauss6);
+		vector<SparseMatrixRowMajor> P;
+		mesh.prolongations(P);
+
+		vector<Point> points = mesh.vertices();
+		ColVector z(points.size());
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			z[i] = points[i].z();
+		}
+
+		vector<std::pair<string, SparseMatrixRowMajor>> systems;
+		systems.emplace_back("Poisson", A);
+		systems.emplace_back("diffusion", A + M / 0.01);
+		for (const auto& system : systems)
+		{
+			ColVector b = M * z;
+			auto t0 = steady_clock::now();
+			SolverBiCGSTAB bicgstab(system.second);
+			ColVector x = bicgstab.solve(b);
+			auto t1 = steady_clock::now();
+
+			std::cout << "  | " << std::setw(5) << level
+				<< " | " << std::setw(7) << points.size()
+				<< " | " << std::left << std::setw(9) << system.first << std::right
+				<< " | " << std::setw(8) << bicgstab.iterations()
+				<< " | " << std::setw(12) << seconds(t0, t1);
+			for (Multigrid::Cycle cycle : { Multigrid::Cycle::V, Multigrid::Cycle::W })
+			{
+				auto t2 = steady_clock::now();
+				Multigrid mg;
+				mg.set(cycle);
+				mg.compute(system.second, P);
+				x = ColVector::Zero(b.size());
+				size_t iterations = mg.solve(b, x);
+				auto t3 = steady_clock::now();
+				std::cout << " | " << std::setw(7) << iterations
+					<< " | " << std::setw(12) << seconds(t2, t3);
+			}
+			std::cout << " |\n";
+		}
+	}
+
+	return 0;
+}
+
+int benchmark_matrixfree(int level)
+{
+	TriangularMesh mesh;
+	if (!generate_icosahedron(mesh, level))
+	{
+		return 1;
+	}
+
+	const int products = 50;
+	const double timestep = 0.01;
+	std::cout << "Stiffness and mass matrices on a refined icosahedron (level "
+		<< level << ", V = " << mesh.statistics().V << "): assembled vs"
+		<< " matrix-free\n"
+		<< "  " << products << " products with A + M/" << timestep << ".\n\n"
+		<< "  | operator         |  build (s) | memory (MB) | products (s) |"
+		<< " max |y - y_assembled| |\n"
+		<< "  | ---------------- | ----------:| -----------:| ------------:|"
+		<< " ---------------------:|\n";
+
+	auto megabytes = [](const SparseMatrixRowMajor& A) {
+		return (A.nonZeros() * (sizeof(double) + sizeof(int))
+			+ (A.outerSize() + 1) * sizeof(int)) / 1048576.0;
+	};
+
+	// Assembled as the time-dependent solver does, with the left-hand side
+	// of a step in a matrix of its own
+	auto t0 = steady_clock::now();
+	SparseMatrixRowMajor A, M;
+	mesh.fill(A, M, Triangle::Integrator::Gauss6);
+	for (int k = 0; k < A.outerSize(); ++k)
+	{
+		double* diagonal = nullptr;
+		double sum = 0;
+		for (SparseMatrixRowMajor::InnerIterator it(A, k); it; ++it)
+		{
+			if (it.col() == k)
+			{
+				diagonal = &it.valueRef();
+			}
+			else
+			{
+				sum += it.value();
+			}
+		}
+		*diagonal = -sum;
+	}
+	SparseMatrixRowMajor LHS = A + M / timestep;
+	auto t1 = steady_clock::now();
+
+	ColVector x = ColVector::Ones(A.cols()), y = x, reference;
+	auto t2 = steady_clock::now();
+	for (int r = 0; r < products; ++r)
+	{
+		y = LHS * x;
+		x = y.normalized();
+	}
+	auto t3 = steady_clock::now();
+	reference = y;
+	std::cout << "  | " << std::left << std::setw(16) << "assembled" << std::right
+		<< " | " << std::setw(10) << seconds(t0, t1)
+		<< " | " << std::setw(11) << megabytes(A) + megabytes(M) + megabytes(LHS)
+		<< " | " << std::setw(12) << seconds(t2, t3)
+		<< " | " << std::setw(21) << 0 << " |\n";
+	LHS = SparseMatrixRowMajor();
+	A = SparseMatrixRowMajor();
+	M = SparseMatrixRowMajor();
+
+	auto t4 = steady_clock::now();
+	Cartosphere::FEMOperator op(mesh, Triangle::Integrator::Gauss6);
+	Cartosphere::FEMOperator step = op.scaled(1, 1 / timestep);
+	auto t5 = steady_clock::now();
+
+	x = ColVector::Ones(x.size());
+	auto t6 = steady_clock::now();
+	for (int r = 0; r < products; ++r)
+	{
+		y = step * x;
+		x = y.normalized();
+	}
+	auto t7 = steady_clock::now();
+	std::cout << "  | " << std::left << std::setw(16) << "matrix-free" << std::right
+		<< " | " << std::setw(10) << seconds(t4, t5)
+		<< " | " << std::setw(11) << op.memory() / 1048576.0
+		<< " | " << std::setw(12) << seconds(t6, t7)
+		<< " | " << std::setw(21) << (y - reference).cwiseAbs().maxCoeff() << " |\n";
+
+	return 0;
+}
+
+int benchmark_explicit(int level)
+{
+	TriangularMesh mesh;
+	if (!generate_icosahedron(mesh, level))
+	{
+		return 1;
+	}
+	vector<Point> points = mesh.vertices();
+
+	// 2 + z decays to 2 + z exp(-2t), z being an eigenfunction of -Laplacian
+	const double duration = 0.1;
+	TimeDependentSolver probe;
+	probe.set(mesh);
+	std::cout << "Diffusion of 2 + z on a refined icosahedron (level " << level
+		<< ", V = " << points.size() << ") until t = " << duration
+		<< ": implicit vs explicit\n"
+		<< "  Forward Euler with the lumped mass matrix is stable up to "
+		<< probe.stableTimestep() << ".\n\n"
+		<< "  | scheme         | timestep | stages |   time (s) |   max error |\n"
+		<< "  | -------------- | --------:| ------:| ----------:| -----------:|\n";
+
+	vector<std::pair<string, TimeDependentSolver::Scheme>> schemes = {
+		{ "backward Euler", TimeDependentSolver::Scheme::BackwardEuler },
+		{ "forward Euler", TimeDependentSolver::Scheme::ForwardEuler },
+		{ "RKL2", TimeDependentSolver::Scheme::RKL2 },
+	};
+	for (const auto& scheme : schemes)
+	{
+		for (double timestep : { 1e-2, 1e-3 })
+		{
+			TimeDependentSolver s;
+			s.set(mesh);
+			s.set(scheme.second);
+			s.set([](const Point&) -> double { return 0; });
+			s.initialize([](const Point& x) -> double { return 2 + x.z(); });
+
+			auto t0 = steady_clock::now();
+			int steps = (int)std::lround(duration / timestep);
+			for (int k = 0; k < steps; ++k)
+			{
+				s.advance(timestep);
+			}
+			auto t1 = steady_clock::now();
+
+			const vector<double>& values = s.values();
+			double error = 0;
+			for (size_t i = 0; i < points.size(); ++i)
+			{
+				double exact = 2 + points[i].z() * std::exp(-2 * duration);
+				error = std::max(error, std::abs(values[i] - exact));
+			}
+
+			// Substeps of forward Euler, or stages of RKL2
+			size_t stages = 1;
+			if (scheme.second == TimeDependentSolver::Scheme::ForwardEuler)
+			{
+				stages = (size_t)std::ceil(timestep / s.stableTimestep());
+			}
+			else if (scheme.second == TimeDependentSolver::Scheme::RKL2)
+			{
+				stages = s.stages();
+			}
+			std::cout << "  | " << std::left << std::setw(14) << scheme.first << std::right
+				<< " | " << std::setw(8) << timestep
+				<< " | " << std::setw(6) << stages
+				<< " | " << std::setw(10) << seconds(t0, t1)
+				<< " | " << std::setw(11) << error << " |\n";
+		}
+	}
+
+	return 0;
+}
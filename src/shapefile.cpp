@@ -243,3 +243,34 @@ ShapeFile::gather() const
 
 	return points;
 }
+
+vector<vector<Cartosphere::Polygon>>
+ShapeFile::regions() const
+{
+	vector<vector<Cartosphere::Polygon>> regions;
+
+	for (const auto& shape : shapes)
+	{
+		vector<Cartosphere::Polygon> rings;
+		if (shape && shape->type == PolygonType)
+		{
+			const Polygon& polygon = *static_cast<const Polygon*>(shape.get());
+			vector<int> delimiters = polygon.parts;
+			delimiters.push_back((int)polygon.points.size());
+			for (int k = 0; k < polygon.numParts; ++k)
+			{
+				// x is the longitude and y is the latitude, both in degrees
+				Cartosphere::Polygon ring;
+				for (int i = delimiters[k]; i < delimiters[k + 1]; ++i)
+				{
+					const auto& point = polygon.points[i];
+					ring.emplace_back(cs_deg2rad(90 - point.y), cs_deg2rad(point.x));
+				}
+				rings.push_back(ring);
+			}
+		}
+		regions.push_back(rings);
+	}
+
+	return regions;
+}
@@ -3,6 +3,265 @@
 
 using namespace Cartosphere;
 
+FEMOperator::FEMOperator(const TriangularMesh& mesh, Triangle::Integrator intr)
+	: _mesh(&mesh)
+{
+	auto stat = mesh.statistics();
+	size_t F = stat.F;
+	_rows = (Eigen::Index)stat.V;
+	auto locals = std::make_shared<vector<_Local>>(F);
+#pragma omp parallel for if (F >= 1024) num_threads(ThreadsMaximum)
+	for (int k = 0; k < (int)F; ++k)
+	{
+		double A[3][3], M[3][3];
+		mesh.local(k, A, M, intr);
+		_Local& local = (*locals)[k];
+		local.a[0] = A[0][1];
+		local.a[1] = A[1][2];
+		local.a[2] = A[2][0];
+		local.m[0] = M[0][0];
+		local.m[1] = M[1][0];
+		local.m[2] = M[1][1];
+		local.m[3] = M[2][0];
+		local.m[4] = M[2][1];
+		local.m[5] = M[2][2];
+	}
+	_locals = locals;
+
+	// Colour the chunks greedily so that chunks of a colour share no vertex,
+	// from the chunks touching each vertex
+	typedef TriangularMesh::Index Index;
+	size_t chunks = (F + ChunkFaces - 1) / ChunkFaces;
+	vector<Index> keys(3 * F), values(3 * F);
+	for (size_t k = 0; k < F; ++k)
+	{
+		for (size_t i = 0; i < 3; ++i)
+		{
+			keys[3 * k + i] = mesh.faceVertices(k)[i];
+			values[3 * k + i] = (Index)(k / ChunkFaces);
+		}
+	}
+	TriangularMesh::Adjacency touching;
+	touching.build(stat.V, keys, values);
+	vector<Index>().swap(keys);
+
+	vector<Index> colour(chunks, TriangularMesh::NoIndex);
+	Index colours = 0;
+	vector<bool> used;
+	for (size_t c = 0; c < chunks; ++c)
+	{
+		used.assign(colours + 1, false);
+		for (size_t k = c * ChunkFaces; k < std::min(F, (c + 1) * ChunkFaces); ++k)
+		{
+			for (Index v : mesh.faceVertices(k))
+			{
+				for (Index d : touching[v])
+				{
+					if (colour[d] != TriangularMesh::NoIndex)
+					{
+						used[colour[d]] = true;
+					}
+				}
+			}
+		}
+		colour[c] = (Index)(std::find(used.begin(), used.end(), false) - used.begin());
+		colours = std::max(colours, (Index)(colour[c] + 1));
+	}
+	values.resize(chunks);
+	std::iota(values.begin(), values.end(), (Index)0);
+	_chunks.build(colours, colour, values);
+}
+
+void
+FEMOperator::apply(const double* x, double* y) const
+{
+	std::fill(y, y + _rows, 0.0);
+	if (!_locals)
+	{
+		return;
+	}
+
+	// Chunks of a colour share no vertex, so they add to y independently
+	const vector<_Local>& locals = *_locals;
+	for (size_t c = 0; c < _chunks.size(); ++c)
+	{
+		TriangularMesh::Adjacency::List chunks = _chunks[c];
+#pragma omp parallel for if (chunks.size() >= 2) num_threads(ThreadsMaximum)
+		for (int n = 0; n < (int)chunks.size(); ++n)
+		{
+			size_t first = chunks[n] * ChunkFaces;
+			size_t last = std::min(locals.size(), first + ChunkFaces);
+			for (size_t k = first; k < last; ++k)
+			{
+				const TriangularMesh::IndexTriplet& v = _mesh->faceVertices(k);
+				const double* a = locals[k].a;
+				const double* m = locals[k].m;
+				double x0 = x[v[0]], x1 = x[v[1]], x2 = x[v[2]];
+				y[v[0]] += _cA * (a[0] * (x1 - x0) + a[2] * (x2 - x0))
+					+ _cM * (m[0] * x0 + m[1] * x1 + m[3] * x2);
+				y[v[1]] += _cA * (a[0] * (x0 - x1) + a[1] * (x2 - x1))
+					+ _cM * (m[1] * x0 + m[2] * x1 + m[4] * x2);
+				y[v[2]] += _cA * (a[2] * (x0 - x2) + a[1] * (x1 - x2))
+					+ _cM * (m[3] * x0 + m[4] * x1 + m[5] * x2);
+			}
+		}
+	}
+}
+
+ColVector
+FEMOperator::diagonal() const
+{
+	ColVector D = ColVector::Zero(_rows);
+	if (!_locals)
+	{
+		return D;
+	}
+	const vector<_Local>& locals = *_locals;
+	for (size_t k = 0; k < locals.size(); ++k)
+	{
+		const TriangularMesh::IndexTriplet& v = _mesh->faceVertices(k);
+		const double* a = locals[k].a;
+		const double* m = locals[k].m;
+		D[v[0]] += _cM * m[0] - _cA * (a[0] + a[2]);
+		D[v[1]] += _cM * m[2] - _cA * (a[0] + a[1]);
+		D[v[2]] += _cM * m[5] - _cA * (a[1] + a[2]);
+	}
+	return D;
+}
+
+void
+Multigrid::compute(const SparseMatrixRowMajor& A,
+	const vector<SparseMatrixRowMajor>& P)
+{
+	// Restrict the operator down the levels
+	_P = P;
+	_A.resize(P.size() + 1);
+	_A.back() = A;
+	for (size_t l = P.size(); l > 0; --l)
+	{
+		_A[l - 1] = P[l - 1].transpose() * (_A[l] * P[l - 1]);
+	}
+
+	_D.resize(_A.size());
+	for (size_t l = 0; l < _A.size(); ++l)
+	{
+		_D[l] = _A[l].diagonal().cwiseInverse();
+	}
+
+	if ((size_t)_A[0].rows() <= DenseMaximum)
+	{
+		_coarse = SparseMatrixColMajor();
+		_dense.compute(Matrix(_A[0]));
+	}
+	else
+	{
+		_coarse = _A[0];
+		_cg.setTolerance(1e-12);
+		_cg.compute(_coarse);
+	}
+}
+
+void
+Multigrid::cycle(const ColVector& b, ColVector& x) const
+{
+	_cycle_level(_A.size() - 1, b, x);
+}
+
+size_t
+Multigrid::solve(const ColVector& b, ColVector& x) const
+{
+	const SparseMatrixRowMajor& A = _A.back();
+	double limit = _tolerance * b.norm();
+	ColVector r = b - A * x;
+	if (r.norm() <= limit)
+	{
+		return 0;
+	}
+
+	ColVector z = ColVector::Zero(b.size());
+	cycle(r, z);
+	ColVector p = z;
+	double rz = r.dot(z);
+	for (size_t k = 1; k <= IterationsMaximum; ++k)
+	{
+		ColVector q = A * p;
+		double pq = p.dot(q);
+		// The stiffness matrix is only semi-definite
+		if (pq <= 0 || rz <= 0)
+		{
+			return k;
+		}
+		double alpha = rz / pq;
+		x += alpha * p;
+		r -= alpha * q;
+		if (r.norm() <= limit)
+		{
+			return k;
+		}
+
+		z.setZero();
+		cycle(r, z);
+		double rz_next = r.dot(z);
+		p = z + (rz_next / rz) * p;
+		rz = rz_next;
+	}
+	return IterationsMaximum;
+}
+
+void
+Multigrid::_cycle_level(size_t l, const ColVector& b, ColVector& x) const
+{
+	if (l == 0)
+	{
+		if (_coarse.size() == 0)
+		{
+			x = _dense.solve(b);
+		}
+		else
+		{
+			x = _cg.solveWithGuess(b, x);
+		}
+		return;
+	}
+
+	// Pre-smooth forwards and post-smooth backwards, so the cycle is
+	// symmetric and can precondition conjugate gradients
+	_smooth(l, b, x, true);
+	ColVector r = _P[l - 1].transpose() * (b - _A[l] * x);
+	ColVector e = ColVector::Zero(r.size());
+	size_t corrections = _cycle == Cycle::W && l > 1 ? 2 : 1;
+	for (size_t k = 0; k < corrections; ++k)
+	{
+		_cycle_level(l - 1, r, e);
+	}
+	x += _P[l - 1] * e;
+	_smooth(l, b, x, false);
+}
+
+void
+Multigrid::_smooth(size_t l, const ColVector& b, ColVector& x, bool forward) const
+{
+	const SparseMatrixRowMajor& A = _A[l];
+	const int* outer = A.outerIndexPtr();
+	const int* inner = A.innerIndexPtr();
+	const double* value = A.valuePtr();
+	const double* D = _D[l].data();
+	int n = (int)A.rows();
+	for (size_t s = 0; s < _sweeps; ++s)
+	{
+		for (int k = 0; k < n; ++k)
+		{
+			int i = forward ? k : n - 1 - k;
+			double r = b[i];
+			for (int j = outer[i]; j < outer[i + 1]; ++j)
+			{
+				r -= value[j] * x[inner[j]];
+			}
+			x[i] += r * D[i];
+		}
+	}
+}
+
 void
 SteadyStateSolver::solve(Function f)
 {
@@ -20,8 +279,22 @@ SteadyStateSolver::solve(Function f)
 	// Solve the linear system
 	// ***********************
 
-	SolverBiCGSTAB kernel(A);
-	ColVector x = kernel.solve(F);
+	// Meshes refined from a kept hierarchy are solved by multigrid
+	ColVector x;
+	vector<SparseMatrixRowMajor> P;
+	_mesh.prolongations(P);
+	if (!P.empty())
+	{
+		Multigrid kernel;
+		kernel.compute(A, P);
+		x = ColVector::Zero(F.size());
+		kernel.solve(F, x);
+	}
+	else
+	{
+		SolverBiCGSTAB kernel(A);
+		x = kernel.solve(F);
+	}
 
 	// ******************
 	// Process the output
@@ -60,14 +333,33 @@ SteadyStateSolver::solve(Function f)
 	}
 }
 
+void
+TimeDependentSolver::_copy(const TimeDependentSolver& other)
+{
+	_m = other._m;
+	_cache.clear();
+	_capacity = other._capacity;
+	_solver = other._solver;
+	_statistics = other._statistics;
+	_scheme = other._scheme;
+	_lumped = other._lumped;
+	_radius = other._radius;
+	_stages = other._stages;
+	_v = other._v;
+	_A = other._A;
+	_M = other._M;
+	_op = other._op.rebound(_m);
+	_P = other._P;
+	_b = other._b;
+	_a = other._a;
+	_f = other._f;
+}
+
 double
 TimeDependentSolver::advanceCrankNicolson(double timestep)
 {
-	SparseMatrixRowMajor LHS = _A / 2 + _M / timestep;
-	ColVector RHS = _b + (_M / timestep - _A / 2) * _a;
-
-	SolverBiCGSTAB s(LHS);
-	ColVector a = s.solve(RHS);
+	ColVector RHS = _b + _product(-0.5, 1 / timestep, _a);
+	ColVector a = _solve(0.5, 1 / timestep, RHS);
 
 	_a = a;
 
@@ -82,18 +374,200 @@ TimeDependentSolver::advanceCrankNicolson(double timestep)
 	return 0;
 }
 
+ColVector
+TimeDependentSolver::_solve(double cA, double cM, const ColVector& RHS)
+{
+	auto it = std::find_if(_cache.begin(), _cache.end(),
+		[cA, cM](const auto& s) { return s->cA == cA && s->cM == cM; }
+	);
+	if (it != _cache.end())
+	{
+		++_statistics.hits;
+		std::rotate(_cache.begin(), it, it + 1);
+	}
+	else
+	{
+		++_statistics.misses;
+		// A and M are symmetric, and so is any combination of them
+		auto s = std::make_shared<_System>();
+		s->cA = cA;
+		s->cM = cM;
+		if (_solver == LinearSolver::Multigrid)
+		{
+			// The levels keep their own matrices
+			s->mg.compute(cA * _A + cM * _M, _P);
+		}
+		else if (_solver == LinearSolver::MatrixFree)
+		{
+			s->op = _op.scaled(cA, cM);
+			s->mf.setTolerance(1e-10);
+			s->mf.compute(s->op);
+		}
+		else
+		{
+			s->LHS = cA * _A + cM * _M;
+			if (_solver == LinearSolver::LDLT)
+			{
+				s->ldlt.compute(s->LHS);
+				// The factors are all the solves need
+				s->LHS = SparseMatrixColMajor();
+			}
+			else
+			{
+				s->cg.compute(s->LHS);
+			}
+		}
+		_cache.insert(_cache.begin(), s);
+		if (_cache.size() > _capacity)
+		{
+			_cache.resize(_capacity);
+		}
+	}
+
+	const _System& s = *_cache.front();
+	if (_solver == LinearSolver::LDLT)
+	{
+		return s.ldlt.solve(RHS);
+	}
+	// The previous values are close to the solution of the next step
+	if (_solver == LinearSolver::Multigrid)
+	{
+		ColVector a = _a;
+		s.mg.solve(RHS, a);
+		return a;
+	}
+	if (_solver == LinearSolver::MatrixFree)
+	{
+		return s.mf.solveWithGuess(RHS, _a);
+	}
+	return s.cg.solveWithGuess(RHS, _a);
+}
+
+double
+TimeDependentSolver::stableTimestep()
+{
+	if (_radius == 0)
+	{
+		// M_L^-1 A is similar to a symmetric semi-definite matrix, so the
+		// Rayleigh quotients in the M_L inner product rise to its largest
+		// eigenvalue; the margin covers the rest of the way
+		std::mt19937 engine(0);
+		std::uniform_real_distribution<double> uniform(-1, 1);
+		ColVector x(_lumped.size());
+		for (int i = 0; i < x.size(); ++i)
+		{
+			x[i] = uniform(engine);
+		}
+		double estimate = 0;
+		for (size_t k = 0; k < PowerIterations; ++k)
+		{
+			ColVector y = _product(1, 0, x);
+			estimate = std::max(estimate, x.dot(y) / x.dot(_lumped.cwiseProduct(x)));
+			x = y.cwiseQuotient(_lumped);
+			x /= x.norm();
+		}
+		_radius = RadiusMargin * estimate;
+	}
+	return 2 / _radius;
+}
+
+ColVector
+TimeDependentSolver::_forward_euler(double timestep)
+{
+	size_t substeps = (size_t)std::ceil(timestep / stableTimestep());
+	double tau = timestep / std::max<size_t>(substeps, 1);
+	ColVector a = _a;
+	for (size_t k = 0; k < substeps; ++k)
+	{
+		a += tau * _rate(a);
+	}
+	return a;
+}
+
+ColVector
+TimeDependentSolver::_rkl2(double timestep)
+{
+	// s stages are stable for timesteps up to (s^2 + s - 2) / 4 times that
+	// of forward Euler (Meyer, Balsara and Aslam, 2014)
+	double ratio = timestep / stableTimestep();
+	size_t s = 2;
+	while (s * s + s - 2 < 4 * ratio)
+	{
+		++s;
+	}
+	_stages = s;
+
+	auto b = [](size_t j) {
+		return j < 2 ? 1.0 / 3 : (j * j + j - 2.0) / (2.0 * j * (j + 1));
+	};
+	double w = 4.0 / (s * s + s - 2);
+
+	ColVector L0 = _rate(_a);
+	ColVector y0 = _a;
+	ColVector y1 = _a + (w / 3 * timestep) * L0;
+	for (size_t j = 2; j <= s; ++j)
+	{
+		double mu = (2.0 * j - 1) / j * b(j) / b(j - 1);
+		double nu = -(j - 1.0) / j * b(j) / b(j - 2);
+		double mu_tilde = mu * w;
+		double gamma_tilde = -(1 - b(j - 1)) * mu_tilde;
+		ColVector y2 = mu * y1 + nu * y0 + (1 - mu - nu) * _a
+			+ (mu_tilde * timestep) * _rate(y1) + (gamma_tilde * timestep) * L0;
+		y0 = std::move(y1);
+		y1 = std::move(y2);
+	}
+	return y1;
+}
+
+void
+TimeDependentSolver::adapt(double refine, double coarsen)
+{
+	// The mesh estimates the error from the nodal values and carries them
+	// over to the adapted mesh
+	vector<double> a_vec(_a.size(), 0);
+	for (int i = 0; i < _a.size(); ++i)
+	{
+		a_vec[i] = _a[i];
+	}
+	_m.set(a_vec);
+	_m.adapt(refine, coarsen);
+
+	// Rebuild the system on the adapted mesh
+	_build();
+	const vector<double>& values = _m.values();
+	_a = ColVector(values.size());
+	for (int i = 0; i < _a.size(); ++i)
+	{
+		_a[i] = values[i];
+	}
+	_v = _m.vertices();
+	if (_f)
+	{
+		_m.fill(_b, _f, Cartosphere::Triangle::Integrator::Gauss6);
+	}
+}
+
 vector<FL3>
-TimeDependentSolver::velocity(const vector<Point>& p) const
+TimeDependentSolver::velocity(const vector<Point>& p, vector<size_t>& hints) const
 {
+	// Points move little between steps, so each walk is short
+	_m.locate(p, hints);
 	vector<FL3> u;
 	u.reserve(p.size());
 	for (size_t k = 0; k < p.size(); ++k)
 	{
-		FL3 gradient = _m.gradient(p[k]);
-		double value = _m.interpolate(p[k]);
+		FL3 gradient = _m.gradient(p[k], hints[k]);
+		double value = _m.interpolate(p[k], hints[k]);
 		u.push_back(-gradient / value);
 	}
 	return u;
+}
+
+vector<FL3>
+TimeDependentSolver::velocity(const vector<Point>& p) const
+{
+	vector<size_t> hints;
+	return velocity(p, hints);
 
 	// for (auto& x : p)
 	// {